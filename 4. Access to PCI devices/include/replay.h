@@ -0,0 +1,15 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "rollup.h"
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Пересчёт логов агрегатов в папке dir по готовому файлу измерений.
+// Файл отображается в память и разбирается параллельно по кускам,
+// результат совпадает с потоковым режимом при тех же настройках.
+int run_replay(const std::string& input, const std::string& dir, const std::vector<WindowSpec>& specs,
+               const std::vector<StatColumn>& columns, time_t lateness, unsigned threads);
+
+#endif
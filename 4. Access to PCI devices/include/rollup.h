@@ -0,0 +1,62 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include "window_stats.h"
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Закрытое окно агрегации: начало, среднее и значения дополнительных столбцов
+struct Window {
+    time_t start;
+    double avg;
+    std::vector<double> values;
+};
+
+// Окно агрегации и файл, куда пишутся его строки
+struct WindowSpec {
+    time_t period;
+    std::string file;
+};
+
+// Длительность вида "90", "90s", "1m", "15m", "1h", "1d" (без суффикса — секунды)
+bool parse_duration(const std::string& text, time_t& duration);
+// Длительность окна должна делить сутки нацело, чтобы окна были выровнены по суткам
+bool parse_window_period(const std::string& text, time_t& period);
+// Окна по умолчанию (hourly.log, daily.log) и дополнительные window_<длительность>.log
+std::vector<WindowSpec> window_specs(const std::vector<std::string>& extra);
+
+// Статистика по окнам фиксированной длины, выровненным по эпохе.
+// Окна закрываются по водяному знаку: максимальная метка времени минус
+// допустимое опоздание. Пока водяной знак не прошёл конец окна, оно остаётся
+// открытым и принимает запоздавшие измерения; измерения в уже закрытые окна
+// отбрасываются. Открытых окон немного: примерно lateness / period + 1.
+class Rollup {
+public:
+    Rollup(time_t period, time_t lateness, const std::vector<StatColumn>& columns);
+
+    // Закрытые этим измерением окна дописываются в closed по возрастанию начала
+    void add(time_t timestamp, double temp, std::vector<Window>& closed);
+    // Закрывает все открытые окна
+    void flush(std::vector<Window>& closed);
+
+    uint64_t dropped() const { return late; }
+
+private:
+    void close(std::map<time_t, WindowStats>::iterator it, std::vector<Window>& closed);
+
+    time_t period, lateness;
+    const std::vector<StatColumn>& columns;
+    bool with_quantiles;
+    std::map<time_t, WindowStats> open;
+    bool started = false;
+    time_t max_timestamp = 0;
+    uint64_t late = 0;
+};
+
+void write_window(std::ostream& out, const Window& window);
+
+#endif
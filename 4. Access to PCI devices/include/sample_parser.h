@@ -0,0 +1,30 @@
+#ifndef SAMPLE_PARSER_H
+#define SAMPLE_PARSER_H
+
+#include <ctime>
+#include <string>
+#include <string_view>
+
+// Разбор строк вида "2024-01-15T14:30:00Z,23.456" без выделений памяти.
+// Метка времени разбирается по фиксированным позициям, начало суток
+// кэшируется между вызовами, температура читается через std::from_chars.
+class SampleParser {
+public:
+    static const size_t TIMESTAMP_LENGTH = 20;
+
+    // Строка целиком: метка времени, запятая, температура
+    bool parse(std::string_view line, time_t& timestamp, double& temp);
+    // Только "YYYY-MM-DDTHH:MM:SSZ"
+    bool parse_timestamp(std::string_view text, time_t& timestamp);
+    static bool parse_temperature(std::string_view text, double& temp);
+
+private:
+    char cached_date[10] = {};
+    time_t cached_day = 0;
+    bool has_cached_day = false;
+};
+
+// Обратное преобразование: метка времени в формате "YYYY-MM-DDTHH:MM:SSZ"
+std::string time_to_string(time_t t);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#endif
+
+// Последовательный порт в неблокирующем режиме: fill() дочитывает то, что
+// уже пришло, next_line() выдаёт готовые строки из внутреннего буфера.
+// Ожидание готовности выполняет общий цикл опроса всех портов.
+class SerialPort {
+public:
+    bool open(const std::string& port_name, int baud_rate = 9600);
+    void close();
+    ~SerialPort() { close(); }
+
+#ifndef _WIN32
+    int handle() const { return fd; }
+#endif
+
+    // Читает доступные байты; false, если данных не было
+    bool fill();
+    // Строка действительна до следующего вызова fill()
+    bool next_line(std::string_view& line);
+
+private:
+#ifdef _WIN32
+    HANDLE hSerial = INVALID_HANDLE_VALUE;
+#else
+    int fd = -1;
+#endif
+    bool is_open = false;
+    std::vector<char> buffer = std::vector<char>(8192);
+    size_t begin = 0, end = 0, scanned = 0;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef WINDOW_STATS_H
+#define WINDOW_STATS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Дополнительный столбец в логах агрегатов (после среднего)
+struct StatColumn {
+    enum Kind { Min, Max, Stddev, Quantile } kind;
+    double q = 0;
+};
+
+// Разбор списка вида "min,max,stddev,p50,p95"; false при неизвестном имени
+bool parse_stat_columns(const std::string& spec, std::vector<StatColumn>& columns);
+
+// Приближённые квантили DDSketch: относительная ошибка ALPHA, память
+// ограничена MAX_BINS корзинами на знак, при переполнении сливаются младшие
+class DDSketch {
+public:
+    static constexpr double ALPHA = 0.01;
+    static const int MAX_BINS = 1024;
+
+    void add(double value);
+    double quantile(double q) const;
+
+private:
+    // Корзины ключей [min_key, min_key + MAX_BINS) для |x| одного знака
+    struct Store {
+        std::vector<uint32_t> bins;
+        int min_key = 0;
+        uint64_t count = 0;
+
+        void add(int key);
+    };
+
+    Store positive, negative;
+    uint64_t zero_count = 0;
+};
+
+// Статистика окна за O(1) памяти: сумма, минимум, максимум,
+// дисперсия по Уэлфорду и, если нужны квантили, DDSketch
+class WindowStats {
+public:
+    explicit WindowStats(bool with_quantiles = false) : with_quantiles(with_quantiles) {}
+
+    void add(double value);
+
+    int count() const { return n; }
+    double avg() const { return sum / n; }
+    double value(const StatColumn& column) const;
+
+private:
+    bool with_quantiles;
+    int n = 0;
+    double sum = 0;
+    double min = 0, max = 0;
+    double mean = 0, m2 = 0;
+    DDSketch sketch;
+};
+
+#endif
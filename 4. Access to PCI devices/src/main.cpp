@@ -10,6 +10,14 @@
 #include <filesystem>
 #include <csignal>
 #include <vector>
+#include <string_view>
+#include <cstring>
+#include <charconv>
+
+#include "replay.h"
+#include "rollup.h"
+#include "sample_parser.h"
+#include "serial_port.h"
 
 #ifdef _WIN32
     #include <windows.h>
@@ -17,9 +25,7 @@
     #include <fcntl.h>
     #include <cstdio>
 #else
-    #include <fcntl.h>
-    #include <termios.h>
-    #include <unistd.h>
+    #include <poll.h>
 #endif
 
 using namespace std;
@@ -40,183 +46,170 @@ void setup_signal_handler() {
 #endif
 }
 
-string time_to_string(time_t t) {
-    tm timeinfo;
-#ifdef _WIN32
-    gmtime_s(&timeinfo, &t);
-#else
-    gmtime_r(&t, &timeinfo);
-#endif
-    char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
-    return string(buffer);
-}
-
-class SerialPort {
-#ifdef _WIN32
-    HANDLE hSerial = INVALID_HANDLE_VALUE;
-#else
-    int fd = -1;
-#endif
-    bool is_open = false;
+// Настройки агрегатов, общие для всех датчиков
+vector<WindowSpec> window_config;
+vector<StatColumn> stat_columns;
+time_t allowed_lateness = 0;
+
+// Логи одного датчика: измерения пишутся пачками, агрегаты — при закрытии окна
+class SensorLog {
+    ofstream meas;
+    vector<Rollup> rollups;
+    vector<ofstream> aggregates;
+    string measurement_buffer;
+    int buffered = 0;
+    string label;
+    vector<Window> closed;
+
+    static const int BUFFER_SIZE = 10;
+
+    static string window_name(time_t period) {
+        if (period == 3600) return "час";
+        if (period == 86400) return "день";
+        return to_string(period) + " с";
+    }
 
 public:
-    bool open(const string& port_name, int baud_rate = 9600) {
-#ifdef _WIN32
-        hSerial = CreateFileA(port_name.c_str(), GENERIC_READ, 0, NULL,
-                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
-        if (hSerial == INVALID_HANDLE_VALUE) return false;
-
-        DCB dcbSerialParams = {0};
-        dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
-        if (!GetCommState(hSerial, &dcbSerialParams)) {
-            CloseHandle(hSerial);
-            return false;
-        }
-        dcbSerialParams.BaudRate = baud_rate;
-        dcbSerialParams.ByteSize = 8;
-        dcbSerialParams.StopBits = ONESTOPBIT;
-        dcbSerialParams.Parity = NOPARITY;
-        if (!SetCommState(hSerial, &dcbSerialParams)) {
-            CloseHandle(hSerial);
-            return false;
+    int total_count = 0;
+
+    bool open(const string& dir, const string& sensor_id) {
+        filesystem::create_directories(dir);
+        meas.open(dir + "/measurements.log", ios::app);
+        if (!meas) return false;
+        for (const auto& spec : window_config) {
+            rollups.emplace_back(spec.period, allowed_lateness, stat_columns);
+            aggregates.emplace_back(dir + "/" + spec.file, ios::app);
+            if (!aggregates.back()) return false;
         }
-#else
-        fd = ::open(port_name.c_str(), O_RDONLY | O_NOCTTY);
-        if (fd == -1) return false;
-
-        termios options;
-        tcgetattr(fd, &options);
-        cfsetispeed(&options, baud_rate);
-        cfsetospeed(&options, baud_rate);
-        options.c_cflag |= (CLOCAL | CREAD);
-        options.c_cflag &= ~PARENB;
-        options.c_cflag &= ~CSTOPB;
-        options.c_cflag &= ~CSIZE;
-        options.c_cflag |= CS8;
-        options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-        options.c_iflag &= ~(IXON | IXOFF | IXANY);
-        options.c_oflag &= ~OPOST;
-        tcsetattr(fd, TCSANOW, &options);
-#endif
-        is_open = true;
+        label = sensor_id.empty() ? "" : "[" + sensor_id + "] ";
         return true;
     }
 
-    bool read_line(string& line, int timeout_ms = 1000) {
-        if (!is_open) return false;
+    void add(string_view time_str, time_t timestamp, double temp) {
+        char temp_text[32];
+        auto res = to_chars(temp_text, temp_text + sizeof(temp_text), temp, chars_format::fixed, 6);
+        measurement_buffer.append(time_str).append(1, ',').append(temp_text, res.ptr).append(1, '\n');
 
-        line.clear();
-        char ch;
-        auto start = steady_clock::now();
+        if (++buffered >= BUFFER_SIZE) {
+            meas << measurement_buffer;
+            meas.flush();
+            measurement_buffer.clear();
+            buffered = 0;
+            cerr << label << "Записано " << BUFFER_SIZE << " измерений" << endl;
+        }
 
-        while (!stop_flag) {
-            auto now = steady_clock::now();
-            auto elapsed = duration_cast<milliseconds>(now - start);
-            if (elapsed.count() > timeout_ms) return false;
+        total_count++;
 
-#ifdef _WIN32
-            DWORD bytes_read;
-            if (ReadFile(hSerial, &ch, 1, &bytes_read, NULL)) {
-                if (bytes_read == 1) {
-                    if (ch == '\n' || ch == '\r') {
-                        if (!line.empty()) return true;
-                    } else {
-                        line += ch;
-                    }
-                }
-            }
-#else
-            int n = ::read(fd, &ch, 1);
-            if (n == 1) {
-                if (ch == '\n' || ch == '\r') {
-                    if (!line.empty()) return true;
-                } else {
-                    line += ch;
-                }
-            } else if (n == 0) {
-                this_thread::sleep_for(milliseconds(10));
+        for (size_t i = 0; i < rollups.size(); i++) {
+            rollups[i].add(timestamp, temp, closed);
+            if (closed.empty()) continue;
+            for (const auto& window : closed) {
+                write_window(aggregates[i], window);
+                cerr << label << "Среднее за " << window_name(window_config[i].period) << ": " << window.avg << endl;
             }
-#endif
+            aggregates[i].flush();
+            closed.clear();
         }
-        return false;
     }
 
     void close() {
-        if (is_open) {
-#ifdef _WIN32
-            CloseHandle(hSerial);
-#else
-            ::close(fd);
-#endif
-            is_open = false;
+        meas << measurement_buffer;
+        measurement_buffer.clear();
+        buffered = 0;
+
+        for (size_t i = 0; i < rollups.size(); i++) {
+            rollups[i].flush(closed);
+            for (const auto& window : closed) write_window(aggregates[i], window);
+            closed.clear();
         }
     }
 
-    ~SerialPort() { close(); }
+    // Измерения, пришедшие в уже закрытое окно (считается по самому короткому окну)
+    uint64_t dropped() const {
+        uint64_t result = 0;
+        for (const auto& rollup : rollups) result = rollup.dropped() > result ? rollup.dropped() : result;
+        return result;
+    }
 };
 
-bool read_from_stdin(double& temp, time_t& timestamp, string& time_str) {
-    string line;
-    if (!getline(cin, line)) return false;
+struct Sensor {
+    string id, path;
+    SerialPort port;
+    SampleParser parser;
+    SensorLog log;
+    string time_str;
+};
 
+// Строка с порта: "время,температура" или только температура.
+// Если метку времени разобрать нельзя, берётся текущее время.
+bool parse_port_line(SampleParser& parser, string_view line, double& temp, time_t& timestamp, string& time_str) {
     size_t comma = line.find(',');
-    if (comma == string::npos) return false;
+    string_view temp_str = comma == string_view::npos ? line : line.substr(comma + 1);
+    if (!SampleParser::parse_temperature(temp_str, temp)) return false;
 
-    time_str = line.substr(0, comma);
-    string temp_str = line.substr(comma + 1);
+    if (comma != string_view::npos && parser.parse_timestamp(line.substr(0, comma), timestamp)) {
+        time_str.assign(line.data(), comma);
+    } else {
+        timestamp = system_clock::to_time_t(system_clock::now());
+        time_str = time_to_string(timestamp);
+    }
+    return true;
+}
 
-    tm tm_struct = {};
-    if (sscanf(time_str.c_str(), "%d-%d-%dT%d:%d:%dZ",
-               &tm_struct.tm_year, &tm_struct.tm_mon, &tm_struct.tm_mday,
-               &tm_struct.tm_hour, &tm_struct.tm_min, &tm_struct.tm_sec) != 6) return false;
+// Дочитывает порт и записывает все полные строки из его буфера
+bool drain_port(Sensor& sensor) {
+    if (!sensor.port.fill()) return false;
 
-    tm_struct.tm_year -= 1900;
-    tm_struct.tm_mon -= 1;
-    tm_struct.tm_isdst = 0;
+    string_view line;
+    double temp;
+    time_t timestamp;
+    while (sensor.port.next_line(line)) {
+        if (parse_port_line(sensor.parser, line, temp, timestamp, sensor.time_str))
+            sensor.log.add(sensor.time_str, timestamp, temp);
+    }
+    return true;
+}
 
+// Один цикл опроса на все порты
+void run_ports(deque<Sensor>& sensors) {
 #ifdef _WIN32
-    timestamp = _mkgmtime(&tm_struct);
+    while (!stop_flag) {
+        bool got_data = false;
+        for (auto& sensor : sensors) got_data |= drain_port(sensor);
+        if (!got_data) this_thread::sleep_for(milliseconds(10));
+    }
 #else
-    timestamp = timegm(&tm_struct);
+    vector<pollfd> fds;
+    for (auto& sensor : sensors) fds.push_back({sensor.port.handle(), POLLIN, 0});
+
+    while (!stop_flag) {
+        if (poll(fds.data(), nfds_t(fds.size()), 1000) <= 0) continue;
+
+        bool got_data = false;
+        for (size_t i = 0; i < fds.size(); i++) {
+            if (fds[i].revents) got_data |= drain_port(sensors[i]);
+        }
+        // Готовность без данных — EOF (например, FIFO без писателя), не крутимся впустую
+        if (!got_data) this_thread::sleep_for(milliseconds(10));
+    }
 #endif
-    temp = stod(temp_str);
-    return true;
 }
 
-bool read_from_port(SerialPort& port, double& temp, time_t& timestamp, string& time_str) {
+void run_stdin(SensorLog& log) {
+    SampleParser parser;
     string line;
-    if (!port.read_line(line)) return false;
+    double temp;
+    time_t timestamp;
 
-    size_t comma = line.find(',');
-    if (comma != string::npos) {
-        time_str = line.substr(0, comma);
-        string temp_str = line.substr(comma + 1);
-
-        tm tm_struct = {};
-        if (sscanf(time_str.c_str(), "%d-%d-%dT%d:%d:%dZ",
-                   &tm_struct.tm_year, &tm_struct.tm_mon, &tm_struct.tm_mday,
-                   &tm_struct.tm_hour, &tm_struct.tm_min, &tm_struct.tm_sec) != 6) {
-            timestamp = system_clock::to_time_t(system_clock::now());
-            time_str = time_to_string(timestamp);
-        } else {
-            tm_struct.tm_year -= 1900;
-            tm_struct.tm_mon -= 1;
-            tm_struct.tm_isdst = 0;
-#ifdef _WIN32
-            timestamp = _mkgmtime(&tm_struct);
-#else
-            timestamp = timegm(&tm_struct);
-#endif
+    while (!stop_flag) {
+        if (!getline(cin, line)) {
+            cin.clear();
+            this_thread::sleep_for(milliseconds(100));
+            continue;
         }
-        temp = stod(temp_str);
-    } else {
-        timestamp = system_clock::to_time_t(system_clock::now());
-        time_str = time_to_string(timestamp);
-        temp = stod(line);
+        if (parser.parse(line, timestamp, temp))
+            log.add(string_view(line).substr(0, SampleParser::TIMESTAMP_LENGTH), timestamp, temp);
     }
-
-    return true;
 }
 
 int main(int argc, char* argv[]) {
@@ -228,142 +221,128 @@ int main(int argc, char* argv[]) {
 #endif
 
     setup_signal_handler();
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
 
-    string port_name;
-    bool use_port = false;
+    deque<Sensor> sensors;
+    string log_dir = "logs", replay_file;
+    unsigned replay_threads = thread::hardware_concurrency();
+    vector<string> extra_windows;
 
     for (int i = 1; i < argc; i++) {
         string arg = argv[i];
         if (arg == "--port" && i + 1 < argc) {
-            port_name = argv[++i];
-            use_port = true;
+            string spec = argv[++i];
+            size_t eq = spec.find('=');
+            Sensor& sensor = sensors.emplace_back();
+            if (eq != string::npos) {
+                sensor.id = spec.substr(0, eq);
+                sensor.path = spec.substr(eq + 1);
+            } else {
+                sensor.path = spec;
+            }
+        } else if (arg == "--logs" && i + 1 < argc) {
+            log_dir = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replay_file = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            string_view text = argv[++i];
+            auto res = from_chars(text.data(), text.data() + text.size(), replay_threads);
+            if (res.ec != errc() || res.ptr != text.data() + text.size() || replay_threads == 0) {
+                cerr << "Ошибка: число потоков должно быть положительным целым: " << text << endl;
+                return 1;
+            }
+        } else if (arg == "--window" && i + 1 < argc) {
+            time_t period;
+            extra_windows.push_back(argv[++i]);
+            if (!parse_window_period(extra_windows.back(), period)) {
+                cerr << "Ошибка: окно должно делить сутки нацело (например 1m, 15m, 2h): " << extra_windows.back() << endl;
+                return 1;
+            }
+        } else if (arg == "--lateness" && i + 1 < argc) {
+            if (!parse_duration(argv[++i], allowed_lateness)) {
+                cerr << "Ошибка: неверная длительность " << argv[i] << endl;
+                return 1;
+            }
+        } else if (arg == "--stats" && i + 1 < argc) {
+            string spec = argv[++i];
+            if (!parse_stat_columns(spec, stat_columns)) {
+                cerr << "Ошибка: неизвестная статистика в " << spec << " (допустимо min, max, stddev, pNN)" << endl;
+                return 1;
+            }
         } else if (arg == "--help") {
             cerr << "Использование:" << endl;
-            cerr << "  " << argv[0] << " [--port COMx]" << endl;
-            cerr << "  --port COMx    : Использовать последовательный порт" << endl;
-            cerr << "                   (COM1, COM2 для Windows; /dev/ttyUSB0, /dev/ttyACM0 для Linux)" << endl;
-            cerr << "  Без аргументов : Чтение данных из stdin (для работы с симулятором)" << endl;
+            cerr << "  " << argv[0] << " [--port [ID=]COMx]... [--logs DIR] [--window W]... [--stats LIST]" << endl;
+            cerr << "  " << argv[0] << " --replay FILE [--threads N] [--logs DIR] [--window W]... [--stats LIST]" << endl;
+            cerr << "  --port [ID=]COMx : Использовать последовательный порт, можно указать несколько раз" << endl;
+            cerr << "                     (COM1, COM2 для Windows; /dev/ttyUSB0, /dev/ttyACM0 для Linux)" << endl;
+            cerr << "                     При нескольких портах логи пишутся в DIR/ID/" << endl;
+            cerr << "  --logs DIR       : Папка логов (по умолчанию logs)" << endl;
+            cerr << "  --window W       : Дополнительное окно агрегации (1m, 15m, ...), лог window_W.log" << endl;
+            cerr << "  --stats LIST     : Столбцы после среднего: min,max,stddev,p50,p95,..." << endl;
+            cerr << "  --lateness T     : Допустимое опоздание измерений (30s, 2m; по умолчанию 0)" << endl;
+            cerr << "  --replay FILE    : Пересчитать логи агрегатов по файлу измерений" << endl;
+            cerr << "  --threads N      : Число потоков для --replay (по умолчанию все ядра)" << endl;
+            cerr << "  Без аргументов   : Чтение данных из stdin (для работы с симулятором)" << endl;
             return 0;
         }
     }
 
-    filesystem::create_directories("logs");
+    window_config = window_specs(extra_windows);
 
-    string meas_file = "logs/measurements.log";
-    string hour_file = "logs/hourly.log";
-    string day_file = "logs/daily.log";
-
-    ofstream meas(meas_file, ios::app);
-    ofstream hourly(hour_file, ios::app);
-    ofstream daily(day_file, ios::app);
-
-    if (!meas || !hourly || !daily) {
-        cerr << "Ошибка открытия файлов логов!" << endl;
-        return 1;
+    if (!replay_file.empty()) {
+        filesystem::create_directories(log_dir);
+        return run_replay(replay_file, log_dir, window_config, stat_columns, allowed_lateness, replay_threads);
     }
 
-    SerialPort serial_port;
-    if (use_port) {
-        if (!serial_port.open(port_name, 9600)) {
-            cerr << "Ошибка: не удалось открыть порт " << port_name << endl;
+    if (sensors.empty()) {
+        SensorLog log;
+        if (!log.open(log_dir, "")) {
+            cerr << "Ошибка открытия файлов логов!" << endl;
             return 1;
         }
-        cerr << "Используется порт: " << port_name << endl;
-    } else {
         cerr << "Режим: чтение из stdin (симулятор)" << endl;
-    }
-
-    cerr << "Температурный логгер запущен" << endl;
-    cerr << "Файлы логов: " << meas_file << ", " << hour_file << ", " << day_file << endl;
-
-    double hour_sum = 0, day_sum = 0;
-    int hour_count = 0, day_count = 0;
-
-    time_t current_hour = 0;
-    time_t current_day = 0;
-
-    vector<string> measurement_buffer;
-    const int BUFFER_SIZE = 10;
-
-    string time_str;
-    double temp;
-    time_t timestamp;
-    int total_count = 0;
+        cerr << "Температурный логгер запущен, логи: " << log_dir << endl;
 
-    while (!stop_flag) {
-        bool success;
-
-        if (use_port) {
-            success = read_from_port(serial_port, temp, timestamp, time_str);
-        } else {
-            success = read_from_stdin(temp, timestamp, time_str);
-        }
-
-        if (!success) {
-            this_thread::sleep_for(milliseconds(100));
-            continue;
-        }
-
-        measurement_buffer.push_back(time_str + "," + to_string(temp));
+        run_stdin(log);
+        log.close();
+        cerr << "Программа завершена. Всего измерений: " << log.total_count
+             << ", опоздавших: " << log.dropped() << endl;
+        return 0;
+    }
 
-        if (measurement_buffer.size() >= BUFFER_SIZE) {
-            for (const auto& entry : measurement_buffer) {
-                meas << entry << "\n";
+    for (auto& sensor : sensors) {
+        if (sensor.id.empty() && sensors.size() > 1) sensor.id = filesystem::path(sensor.path).filename().string();
+        for (auto& other : sensors) {
+            if (&other != &sensor && !other.id.empty() && other.id == sensor.id) {
+                cerr << "Ошибка: повторяющийся идентификатор датчика " << sensor.id << endl;
+                return 1;
             }
-            meas.flush();
-            measurement_buffer.clear();
-            cerr << "Записано " << BUFFER_SIZE << " измерений" << endl;
         }
 
-        total_count++;
-
-        if (current_hour == 0) current_hour = (timestamp / 3600) * 3600;
-        if (current_day == 0) current_day = (timestamp / 86400) * 86400;
-
-        hour_sum += temp;
-        hour_count++;
-        day_sum += temp;
-        day_count++;
-
-        time_t sample_hour = (timestamp / 3600) * 3600;
-        if (sample_hour != current_hour && hour_count > 0) {
-            double hour_avg = hour_sum / hour_count;
-            hourly << time_to_string(current_hour) << "," << fixed << setprecision(3) << hour_avg << "\n";
-            hourly.flush();
-
-            hour_sum = hour_count = 0;
-            current_hour = sample_hour;
-            cerr << "Среднее за час: " << hour_avg << endl;
+        string dir = sensors.size() > 1 ? log_dir + "/" + sensor.id : log_dir;
+        if (!sensor.log.open(dir, sensor.id)) {
+            cerr << "Ошибка открытия файлов логов в " << dir << endl;
+            return 1;
         }
-
-        time_t sample_day = (timestamp / 86400) * 86400;
-        if (sample_day != current_day && day_count > 0) {
-            double day_avg = day_sum / day_count;
-            daily << time_to_string(current_day) << "," << fixed << setprecision(3) << day_avg << "\n";
-            daily.flush();
-
-            day_sum = day_count = 0;
-            current_day = sample_day;
-            cerr << "Среднее за день: " << day_avg << endl;
+        if (!sensor.port.open(sensor.path, 9600)) {
+            cerr << "Ошибка: не удалось открыть порт " << sensor.path << endl;
+            return 1;
         }
+        cerr << "Используется порт: " << sensor.path << " -> " << dir << endl;
     }
 
-    if (!measurement_buffer.empty()) {
-        for (const auto& entry : measurement_buffer) {
-            meas << entry << "\n";
-        }
-    }
+    cerr << "Температурный логгер запущен" << endl;
 
-    if (hour_count > 0) {
-        double hour_avg = hour_sum / hour_count;
-        hourly << time_to_string(current_hour) << "," << fixed << setprecision(3) << hour_avg << "\n";
-    }
+    run_ports(sensors);
 
-    if (day_count > 0) {
-        double day_avg = day_sum / day_count;
-        daily << time_to_string(current_day) << "," << fixed << setprecision(3) << day_avg << "\n";
+    int total_count = 0;
+    uint64_t dropped = 0;
+    for (auto& sensor : sensors) {
+        sensor.log.close();
+        total_count += sensor.log.total_count;
+        dropped += sensor.log.dropped();
     }
-
-    cerr << "Программа завершена. Всего измерений: " << total_count << endl;
+    cerr << "Программа завершена. Всего измерений: " << total_count << ", опоздавших: " << dropped << endl;
     return 0;
-}
\ No newline at end of file
+}
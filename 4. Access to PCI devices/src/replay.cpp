@@ -0,0 +1,214 @@
+#include "replay.h"
+#include "rollup.h"
+#include "sample_parser.h"
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Размер куска для параллельного разбора
+const size_t CHUNK_SIZE = 8 << 20;
+
+// ==================== Отображение файла в память ====================
+
+class MappedFile {
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+    const char* ptr = nullptr;
+    size_t length = 0;
+    bool opened = false;
+
+public:
+    explicit MappedFile(const string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) return;
+        length = size_t(file_size.QuadPart);
+        opened = true;
+        if (length == 0) return;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) ptr = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        opened = ptr != nullptr;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return;
+        length = size_t(st.st_size);
+        opened = true;
+        if (length == 0) return;
+        void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            opened = false;
+            return;
+        }
+        madvise(p, length, MADV_SEQUENTIAL | MADV_WILLNEED);
+        ptr = static_cast<const char*>(p);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (ptr) munmap(const_cast<char*>(ptr), length);
+        if (fd != -1) ::close(fd);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool ok() const { return opened; }
+    const char* data() const { return ptr; }
+    size_t size() const { return length; }
+};
+
+// ==================== Разбор кусков ====================
+
+// Следующая непустая строка, начиная с pos; pos сдвигается за неё
+bool next_line(const char* data, size_t end, size_t& pos, string_view& line) {
+    while (pos < end) {
+        const char* start = data + pos;
+        const char* eol = static_cast<const char*>(memchr(start, '\n', end - pos));
+        size_t length = eol ? size_t(eol - start) : end - pos;
+        pos += length + (eol ? 1 : 0);
+        if (length > 0 && start[length - 1] == '\r') --length;
+        if (length == 0) continue;
+        line = string_view(start, length);
+        return true;
+    }
+    return false;
+}
+
+// Начало строки, следующей за позицией pos (или сама pos, если строка начинается там)
+size_t line_start(const char* data, size_t size, size_t pos) {
+    if (pos == 0) return 0;
+    if (pos >= size) return size;
+    const char* eol = static_cast<const char*>(memchr(data + pos - 1, '\n', size - pos + 1));
+    return eol ? size_t(eol - data) + 1 : size;
+}
+
+struct Sample {
+    time_t timestamp;
+    double temp;
+};
+
+struct ParsedChunk {
+    vector<Sample> samples;
+    size_t rejected = 0;
+};
+
+ParsedChunk parse_chunk(const char* data, size_t begin, size_t end) {
+    ParsedChunk chunk;
+    chunk.samples.reserve((end - begin) / 24);
+    SampleParser parser;
+    string_view line;
+    Sample sample;
+
+    for (size_t pos = begin; next_line(data, end, pos, line);) {
+        if (parser.parse(line, sample.timestamp, sample.temp)) chunk.samples.push_back(sample);
+        else chunk.rejected++;
+    }
+    return chunk;
+}
+
+}
+
+// Разбор — самая дорогая часть, он идёт параллельно по кускам фиксированного
+// размера. Агрегация выполняется одним потоком в порядке файла: с водяным знаком
+// окно может пересекать любую границу куска, а порядок сложения должен совпадать
+// с потоковым режимом. В работе одновременно не больше threads + 1 кусков.
+int run_replay(const string& input, const string& dir, const vector<WindowSpec>& specs,
+               const vector<StatColumn>& columns, time_t lateness, unsigned threads) {
+    auto started = chrono::steady_clock::now();
+
+    MappedFile file(input);
+    if (!file.ok()) {
+        cerr << "Ошибка: не удалось открыть файл " << input << endl;
+        return 1;
+    }
+    if (threads == 0) threads = 1;
+
+    vector<ofstream> outputs;
+    for (const auto& spec : specs) {
+        outputs.emplace_back(dir + "/" + spec.file, ios::trunc);
+        if (!outputs.back()) {
+            cerr << "Ошибка открытия файла " << dir << "/" << spec.file << endl;
+            return 1;
+        }
+    }
+
+    vector<Rollup> rollups;
+    for (const auto& spec : specs) rollups.emplace_back(spec.period, lateness, columns);
+    vector<Window> closed;
+
+    const char* data = file.data();
+    size_t size = file.size();
+    size_t next = 0, samples = 0, rejected = 0, chunks = 0;
+
+    deque<future<ParsedChunk>> pending;
+    auto schedule = [&] {
+        while (next < size && pending.size() <= threads) {
+            size_t end = line_start(data, size, next + CHUNK_SIZE);
+            pending.push_back(async(launch::async, parse_chunk, data, next, end));
+            next = end;
+        }
+    };
+
+    for (schedule(); !pending.empty(); schedule()) {
+        ParsedChunk chunk = pending.front().get();
+        pending.pop_front();
+        chunks++;
+        samples += chunk.samples.size();
+        rejected += chunk.rejected;
+
+        for (const auto& sample : chunk.samples) {
+            for (size_t i = 0; i < rollups.size(); i++) {
+                rollups[i].add(sample.timestamp, sample.temp, closed);
+                for (const auto& window : closed) write_window(outputs[i], window);
+                closed.clear();
+            }
+        }
+    }
+
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < rollups.size(); i++) {
+        rollups[i].flush(closed);
+        for (const auto& window : closed) write_window(outputs[i], window);
+        closed.clear();
+        dropped += rollups[i].dropped();
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    cerr << "Пересчёт завершён: " << samples << " измерений, " << rejected << " строк пропущено, "
+         << dropped << " опоздавших отброшено, " << chunks << " кусков, "
+         << fixed << setprecision(2) << seconds << " с" << endl;
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "rollup.h"
+#include "sample_parser.h"
+#include <charconv>
+#include <iomanip>
+#include <limits>
+
+static const time_t DAY = 86400;
+
+static bool has_quantiles(const std::vector<StatColumn>& columns) {
+    for (const auto& column : columns)
+        if (column.kind == StatColumn::Quantile) return true;
+    return false;
+}
+
+bool parse_duration(const std::string& text, time_t& duration) {
+    size_t digits = 0;
+    while (digits < text.size() && text[digits] >= '0' && text[digits] <= '9') ++digits;
+    if (digits == 0 || digits + 1 < text.size()) return false;
+
+    time_t unit = 1;
+    if (digits < text.size()) {
+        switch (text.back()) {
+            case 's': break;
+            case 'm': unit = 60; break;
+            case 'h': unit = 3600; break;
+            case 'd': unit = DAY; break;
+            default: return false;
+        }
+    }
+    // Слишком большое число — ошибка разбора, а не исключение или переполнение
+    time_t value = 0;
+    auto res = std::from_chars(text.data(), text.data() + digits, value);
+    if (res.ec != std::errc() || value > std::numeric_limits<time_t>::max() / unit) return false;
+    duration = value * unit;
+    return true;
+}
+
+bool parse_window_period(const std::string& text, time_t& period) {
+    return parse_duration(text, period) && period > 0 && DAY % period == 0;
+}
+
+std::vector<WindowSpec> window_specs(const std::vector<std::string>& extra) {
+    std::vector<WindowSpec> specs{{3600, "hourly.log"}, {DAY, "daily.log"}};
+    for (const auto& text : extra) {
+        time_t period;
+        if (parse_window_period(text, period)) specs.push_back({period, "window_" + text + ".log"});
+    }
+    return specs;
+}
+
+Rollup::Rollup(time_t period, time_t lateness, const std::vector<StatColumn>& columns)
+    : period(period), lateness(lateness), columns(columns), with_quantiles(has_quantiles(columns)) {}
+
+void Rollup::add(time_t timestamp, double temp, std::vector<Window>& closed) {
+    time_t start = (timestamp / period) * period;
+    if (started && start + period <= max_timestamp - lateness) {
+        late++;
+        return;
+    }
+
+    auto it = open.find(start);
+    if (it == open.end()) it = open.emplace(start, WindowStats(with_quantiles)).first;
+    it->second.add(temp);
+
+    if (!started || timestamp > max_timestamp) max_timestamp = timestamp;
+    started = true;
+
+    time_t watermark = max_timestamp - lateness;
+    while (!open.empty() && open.begin()->first + period <= watermark) close(open.begin(), closed);
+}
+
+void Rollup::flush(std::vector<Window>& closed) {
+    while (!open.empty()) close(open.begin(), closed);
+}
+
+void Rollup::close(std::map<time_t, WindowStats>::iterator it, std::vector<Window>& closed) {
+    const WindowStats& stats = it->second;
+    Window window{it->first, stats.avg(), {}};
+    for (const auto& column : columns) window.values.push_back(stats.value(column));
+    closed.push_back(std::move(window));
+    open.erase(it);
+}
+
+void write_window(std::ostream& out, const Window& window) {
+    out << time_to_string(window.start) << "," << std::fixed << std::setprecision(3) << window.avg;
+    for (double value : window.values) out << "," << value;
+    out << "\n";
+}
@@ -0,0 +1,69 @@
+#include "sample_parser.h"
+#include <charconv>
+#include <cstring>
+
+static bool digits(const char* p, int count, int& value) {
+    value = 0;
+    for (int i = 0; i < count; ++i) {
+        unsigned d = unsigned(p[i] - '0');
+        if (d > 9) return false;
+        value = value * 10 + int(d);
+    }
+    return true;
+}
+
+// Число дней от 1970-01-01 по григорианскому календарю (алгоритм Howard Hinnant)
+static long long days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = unsigned(y - era * 400);
+    const unsigned doy = unsigned((153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1);
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return (long long)era * 146097 + (long long)doe - 719468;
+}
+
+bool SampleParser::parse_timestamp(std::string_view text, time_t& timestamp) {
+    if (text.size() != TIMESTAMP_LENGTH) return false;
+    const char* p = text.data();
+    if (p[4] != '-' || p[7] != '-' || p[10] != 'T' || p[13] != ':' || p[16] != ':' || p[19] != 'Z') return false;
+
+    if (!has_cached_day || memcmp(p, cached_date, sizeof(cached_date)) != 0) {
+        int year, month, day;
+        if (!digits(p, 4, year) || !digits(p + 5, 2, month) || !digits(p + 8, 2, day)) return false;
+        if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+        cached_day = time_t(days_from_civil(year, month, day) * 86400);
+        memcpy(cached_date, p, sizeof(cached_date));
+        has_cached_day = true;
+    }
+
+    int hour, minute, second;
+    if (!digits(p + 11, 2, hour) || !digits(p + 14, 2, minute) || !digits(p + 17, 2, second)) return false;
+    if (hour > 23 || minute > 59 || second > 60) return false;
+    timestamp = cached_day + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+bool SampleParser::parse_temperature(std::string_view text, double& temp) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '+')) text.remove_prefix(1);
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\r')) text.remove_suffix(1);
+    auto res = std::from_chars(text.data(), text.data() + text.size(), temp);
+    return res.ec == std::errc() && res.ptr == text.data() + text.size();
+}
+
+bool SampleParser::parse(std::string_view line, time_t& timestamp, double& temp) {
+    size_t comma = line.find(',');
+    if (comma == std::string_view::npos) return false;
+    return parse_timestamp(line.substr(0, comma), timestamp) && parse_temperature(line.substr(comma + 1), temp);
+}
+
+std::string time_to_string(time_t t) {
+    tm timeinfo;
+#ifdef _WIN32
+    gmtime_s(&timeinfo, &t);
+#else
+    gmtime_r(&t, &timeinfo);
+#endif
+    char buffer[80];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &timeinfo);
+    return std::string(buffer);
+}
@@ -0,0 +1,111 @@
+#include "serial_port.h"
+#include <cstring>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <termios.h>
+    #include <unistd.h>
+#endif
+
+bool SerialPort::open(const std::string& port_name, int baud_rate) {
+#ifdef _WIN32
+    hSerial = CreateFileA(port_name.c_str(), GENERIC_READ, 0, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hSerial == INVALID_HANDLE_VALUE) return false;
+
+    DCB dcbSerialParams = {0};
+    dcbSerialParams.DCBlength = sizeof(dcbSerialParams);
+    if (!GetCommState(hSerial, &dcbSerialParams)) {
+        CloseHandle(hSerial);
+        return false;
+    }
+    dcbSerialParams.BaudRate = baud_rate;
+    dcbSerialParams.ByteSize = 8;
+    dcbSerialParams.StopBits = ONESTOPBIT;
+    dcbSerialParams.Parity = NOPARITY;
+    if (!SetCommState(hSerial, &dcbSerialParams)) {
+        CloseHandle(hSerial);
+        return false;
+    }
+    // ReadFile возвращает сразу то, что уже есть во входном буфере драйвера
+    COMMTIMEOUTS timeouts = {0};
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = 0;
+    timeouts.ReadTotalTimeoutConstant = 0;
+    SetCommTimeouts(hSerial, &timeouts);
+#else
+    fd = ::open(port_name.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd == -1) return false;
+
+    termios options;
+    if (tcgetattr(fd, &options) == 0) {
+        cfsetispeed(&options, baud_rate);
+        cfsetospeed(&options, baud_rate);
+        options.c_cflag |= (CLOCAL | CREAD);
+        options.c_cflag &= ~PARENB;
+        options.c_cflag &= ~CSTOPB;
+        options.c_cflag &= ~CSIZE;
+        options.c_cflag |= CS8;
+        options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+        options.c_iflag &= ~(IXON | IXOFF | IXANY);
+        options.c_oflag &= ~OPOST;
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &options);
+    }
+#endif
+    is_open = true;
+    return true;
+}
+
+void SerialPort::close() {
+    if (is_open) {
+#ifdef _WIN32
+        CloseHandle(hSerial);
+#else
+        ::close(fd);
+#endif
+        is_open = false;
+    }
+}
+
+bool SerialPort::fill() {
+    if (!is_open) return false;
+
+    if (begin > 0) {
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        scanned -= begin;
+        begin = 0;
+    }
+    // Строка длиннее буфера отбрасывается
+    if (end == buffer.size()) begin = end = scanned = 0;
+
+#ifdef _WIN32
+    DWORD bytes_read = 0;
+    if (!ReadFile(hSerial, buffer.data() + end, DWORD(buffer.size() - end), &bytes_read, NULL)) return false;
+    end += bytes_read;
+    return bytes_read > 0;
+#else
+    ssize_t n = ::read(fd, buffer.data() + end, buffer.size() - end);
+    if (n <= 0) return false;
+    end += size_t(n);
+    return true;
+#endif
+}
+
+// Конец строки — '\n', '\r' или пара "\r\n". Пустые строки пропускаются,
+// поэтому '\n' из пары ничего не выдаёт, даже если пришёл следующим чтением
+bool SerialPort::next_line(std::string_view& line) {
+    while (scanned < end) {
+        char c = buffer[scanned++];
+        if (c != '\n' && c != '\r') continue;
+        const char* start = buffer.data() + begin;
+        size_t length = scanned - 1 - begin;
+        begin = scanned;
+        if (length == 0) continue;
+        line = std::string_view(start, length);
+        return true;
+    }
+    return false;
+}
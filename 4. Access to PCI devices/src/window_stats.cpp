@@ -0,0 +1,116 @@
+#include "window_stats.h"
+#include <cmath>
+#include <cstdlib>
+
+bool parse_stat_columns(const std::string& spec, std::vector<StatColumn>& columns) {
+    size_t pos = 0;
+    while (pos <= spec.size()) {
+        size_t comma = spec.find(',', pos);
+        if (comma == std::string::npos) comma = spec.size();
+        std::string name = spec.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        if (name == "min") columns.push_back({StatColumn::Min});
+        else if (name == "max") columns.push_back({StatColumn::Max});
+        else if (name == "stddev") columns.push_back({StatColumn::Stddev});
+        else if (name.size() > 1 && name[0] == 'p') {
+            char* end;
+            double percent = strtod(name.c_str() + 1, &end);
+            if (*end || percent < 0 || percent > 100) return false;
+            columns.push_back({StatColumn::Quantile, percent / 100});
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ==================== DDSketch ====================
+
+static const double GAMMA = (1 + DDSketch::ALPHA) / (1 - DDSketch::ALPHA);
+static const double LOG_GAMMA = std::log(GAMMA);
+// Меньшие по модулю значения считаются нулём
+static const double MIN_INDEXABLE = 1e-9;
+
+static int key_of(double x) { return int(std::ceil(std::log(x) / LOG_GAMMA)); }
+static double value_of(int key) { return 2 * std::pow(GAMMA, key) / (GAMMA + 1); }
+
+void DDSketch::Store::add(int key) {
+    if (bins.empty()) {
+        bins.assign(MAX_BINS, 0);
+        min_key = key - MAX_BINS / 2;
+    }
+    if (key < min_key) {
+        int shift = min_key - key;
+        // Сдвигаем окно вниз, если старшие корзины пусты, иначе сливаем в младшую
+        int top = MAX_BINS - 1;
+        while (top >= 0 && bins[top] == 0) --top;
+        if (top + shift < MAX_BINS) {
+            for (int i = top; i >= 0; --i) bins[i + shift] = bins[i];
+            for (int i = 0; i < shift && i < MAX_BINS; ++i) bins[i] = 0;
+            min_key = key;
+        } else {
+            key = min_key;
+        }
+    } else if (key >= min_key + MAX_BINS) {
+        // Сдвигаем окно вверх, вытесненные корзины сливаются в новую младшую
+        int shift = key - (min_key + MAX_BINS - 1);
+        uint32_t collapsed = 0;
+        for (int i = 0; i < shift && i < MAX_BINS; ++i) collapsed += bins[i];
+        for (int i = shift; i < MAX_BINS; ++i) bins[i - shift] = bins[i];
+        for (int i = MAX_BINS - shift < 0 ? 0 : MAX_BINS - shift; i < MAX_BINS; ++i) bins[i] = 0;
+        bins[0] += collapsed;
+        min_key += shift;
+    }
+    bins[key - min_key]++;
+    count++;
+}
+
+void DDSketch::add(double value) {
+    if (value > MIN_INDEXABLE) positive.add(key_of(value));
+    else if (value < -MIN_INDEXABLE) negative.add(key_of(-value));
+    else zero_count++;
+}
+
+double DDSketch::quantile(double q) const {
+    uint64_t total = negative.count + zero_count + positive.count;
+    if (total == 0) return 0;
+    uint64_t rank = uint64_t(q * double(total - 1));
+
+    // Порядок значений: отрицательные (от больших |x|), нули, положительные
+    uint64_t seen = 0;
+    for (int i = int(negative.bins.size()) - 1; i >= 0; --i) {
+        seen += negative.bins[i];
+        if (seen > rank) return -value_of(negative.min_key + i);
+    }
+    seen += zero_count;
+    if (seen > rank) return 0;
+    for (size_t i = 0; i < positive.bins.size(); ++i) {
+        seen += positive.bins[i];
+        if (seen > rank) return value_of(positive.min_key + int(i));
+    }
+    return 0;
+}
+
+// ==================== WindowStats ====================
+
+void WindowStats::add(double value) {
+    if (n == 0 || value < min) min = value;
+    if (n == 0 || value > max) max = value;
+    n++;
+    sum += value;
+    double delta = value - mean;
+    mean += delta / n;
+    m2 += delta * (value - mean);
+    if (with_quantiles) sketch.add(value);
+}
+
+double WindowStats::value(const StatColumn& column) const {
+    switch (column.kind) {
+        case StatColumn::Min: return min;
+        case StatColumn::Max: return max;
+        case StatColumn::Stddev: return n > 1 ? std::sqrt(m2 / (n - 1)) : 0;
+        case StatColumn::Quantile: return sketch.quantile(column.q);
+    }
+    return 0;
+}
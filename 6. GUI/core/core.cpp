@@ -4,15 +4,19 @@
 #include <thread>
 #include <chrono>
 #include <random>
+#include <cstring>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <fcntl.h>
+#include <poll.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
 
-SerialPort::SerialPort(const std::string& portName) {
+static const size_t READ_CHUNK = 4096;
+
+SerialPort::SerialPort(const std::string& portName) : buffer(2 * READ_CHUNK) {
     name = portName;
 #ifdef _WIN32
     hSerial = CreateFileA(name.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
@@ -26,9 +30,23 @@ SerialPort::SerialPort(const std::string& portName) {
             dcbSerialParams.Parity = NOPARITY;
             SetCommState(hSerial, &dcbSerialParams);
         }
+        COMMTIMEOUTS timeouts = {0};
+        timeouts.ReadIntervalTimeout = MAXDWORD;
+        timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+        timeouts.ReadTotalTimeoutConstant = 1000;
+        SetCommTimeouts(hSerial, &timeouts);
     }
 #else
     fd = open(name.c_str(), O_RDONLY | O_NOCTTY);
+    if (fd != -1 && isatty(fd)) {
+        termios options;
+        tcgetattr(fd, &options);
+        cfmakeraw(&options);
+        options.c_cflag |= (CLOCAL | CREAD);
+        options.c_cc[VMIN] = 0;
+        options.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &options);
+    }
 #endif
 }
 
@@ -48,23 +66,60 @@ bool SerialPort::isOpen() const {
 #endif
 }
 
-bool SerialPort::readLine(std::string& line) {
-    line.clear();
-    char c;
+bool SerialPort::readLine(std::string_view& line, int timeoutMs) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
     while (true) {
+        const char* start = buffer.data() + begin;
+        const char* nl = static_cast<const char*>(std::memchr(buffer.data() + scanned, '\n', end - scanned));
+        if (nl) {
+            size_t length = size_t(nl - start);
+            if (length > 0 && start[length - 1] == '\r') --length;
+            begin = scanned = size_t(nl - buffer.data()) + 1;
+            if (length == 0) continue;
+            line = std::string_view(start, length);
+            return true;
+        }
+        scanned = end;
+        if (begin > 0) {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            end -= begin;
+            scanned -= begin;
+            begin = 0;
+        }
+        if (end == buffer.size()) {
+            begin = end = scanned = 0;
+        }
+        int remaining = int(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                deadline - std::chrono::steady_clock::now()).count());
+        if (remaining <= 0 || !fill(remaining)) return false;
+    }
+}
+
+// Reads whatever is available into the free tail of the buffer, waiting
+// up to timeoutMs for the first byte. Regular files (the simulator's
+// virtual_com) are always readable, so EOF backs off briefly instead.
+bool SerialPort::fill(int timeoutMs) {
 #ifdef _WIN32
-        DWORD bytesRead;
-        if (ReadFile(hSerial, &c, 1, &bytesRead, NULL) && bytesRead > 0) {
-            if (c == '\n') return true;
-            if (c != '\r') line += c;
-        } else return false;
+    DWORD bytesRead = 0;
+    if (!ReadFile(hSerial, buffer.data() + end, DWORD(buffer.size() - end), &bytesRead, NULL)) return false;
+    if (bytesRead == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs < 20 ? timeoutMs : 20));
+        return true;
+    }
+    end += bytesRead;
+    return true;
 #else
-        if (read(fd, &c, 1) > 0) {
-            if (c == '\n') return true;
-            if (c != '\r') line += c;
-        } else return false;
-#endif
+    pollfd p{fd, POLLIN, 0};
+    if (poll(&p, 1, timeoutMs) <= 0) return false;
+    ssize_t n = read(fd, buffer.data() + end, buffer.size() - end);
+    if (n < 0) return false;
+    if (n == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs < 20 ? timeoutMs : 20));
+        return true;
     }
+    end += size_t(n);
+    return true;
+#endif
 }
 
 void Simulator::run() {
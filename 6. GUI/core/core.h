@@ -1,14 +1,24 @@
 #pragma once
 #include <string>
+#include <string_view>
+#include <vector>
 
+// Reads the port in large chunks into an internal buffer and hands out
+// complete lines as views into it; a view stays valid until the next
+// readLine() call. Waits for data with poll() (COMMTIMEOUTS on Windows).
 class SerialPort {
 public:
     SerialPort(const std::string& portName);
     ~SerialPort();
     bool isOpen() const;
-    bool readLine(std::string& line);
+    bool readLine(std::string_view& line, int timeoutMs = 1000);
 private:
+    bool fill(int timeoutMs);
     std::string name;
+    std::vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    size_t scanned = 0;
 #ifdef _WIN32
     void* hSerial;
 #else
@@ -0,0 +1,112 @@
+#include "ingest.h"
+#include <charconv>
+#include <vector>
+
+IngestPipeline::IngestPipeline(SerialPort& port, Database& db, size_t queue_capacity, size_t max_batch,
+                               std::chrono::milliseconds max_delay)
+    : port(port), db(db), queue(queue_capacity), max_batch(max_batch ? max_batch : 1), max_delay(max_delay) {}
+
+IngestPipeline::~IngestPipeline() {
+    stop();
+    wait();
+}
+
+void IngestPipeline::start() {
+    if (reader.joinable()) return;
+    reader = std::thread(&IngestPipeline::read_loop, this);
+    writer = std::thread(&IngestPipeline::write_loop, this);
+}
+
+void IngestPipeline::stop() {
+    stopping = true;
+}
+
+void IngestPipeline::wait() {
+    if (reader.joinable()) reader.join();
+    if (writer.joinable()) writer.join();
+}
+
+void IngestPipeline::read_loop() {
+    std::string_view line;
+    while (!stopping) {
+        if (!port.readLine(line, 200)) continue;
+        lines.fetch_add(1, std::memory_order_relaxed);
+        double temp = 0;
+        auto res = std::from_chars(line.data(), line.data() + line.size(), temp);
+        if (res.ec != std::errc()) {
+            parse_errors.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        Sample sample{Database::now_ms(), temp};
+        if (!queue.push(sample)) {
+            queue_full.fetch_add(1, std::memory_order_relaxed);
+            while (!queue.push(sample) && !stopping) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        wake_writer();
+        uint64_t depth = queue.size();
+        if (depth > max_depth.load(std::memory_order_relaxed)) max_depth.store(depth, std::memory_order_relaxed);
+    }
+    reader_done = true;
+    wake_writer();
+}
+
+// The reader publishes a sample, then checks writer_idle; the writer sets
+// writer_idle, then checks the queue. The fences make at least one side see
+// the other, and the mutex keeps the notify from landing before the wait.
+// The reader only touches the mutex while the writer is asleep.
+void IngestPipeline::wake_writer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!writer_idle.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    wake.notify_one();
+}
+
+void IngestPipeline::wait_for_samples(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    writer_idle.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ready = [this] { return queue.size() > 0 || reader_done; };
+    if (deadline == std::chrono::steady_clock::time_point::max()) wake.wait(lock, ready);
+    else wake.wait_until(lock, deadline, ready);
+    writer_idle.store(false, std::memory_order_relaxed);
+}
+
+// Commits when a batch is full, or once the queue has drained and the
+// oldest pending sample has waited max_delay, so batches grow with load.
+void IngestPipeline::write_loop() {
+    std::vector<Sample> batch;
+    batch.reserve(max_batch);
+    auto first = std::chrono::steady_clock::now();
+    while (true) {
+        Sample sample;
+        bool got = queue.pop(sample);
+        if (got) {
+            if (batch.empty()) first = std::chrono::steady_clock::now();
+            batch.push_back(sample);
+        }
+        bool idle = !got && !batch.empty();
+        if (batch.size() >= max_batch ||
+            (idle && (reader_done || std::chrono::steady_clock::now() - first >= max_delay))) {
+            db.insert_batch(batch);
+            committed.fetch_add(batch.size(), std::memory_order_relaxed);
+            batches.fetch_add(1, std::memory_order_relaxed);
+            batch.clear();
+        }
+        if (!got) {
+            if (reader_done && batch.empty()) return;
+            wait_for_samples(batch.empty() ? std::chrono::steady_clock::time_point::max() : first + max_delay);
+        }
+    }
+}
+
+void IngestPipeline::write_stats(JsonWriter& out) const {
+    out.raw("{\"lines\":").integer(int64_t(lines.load(std::memory_order_relaxed)));
+    out.raw(",\"parse_errors\":").integer(int64_t(parse_errors.load(std::memory_order_relaxed)));
+    out.raw(",\"queue_depth\":").integer(int64_t(queue.size()));
+    out.raw(",\"queue_max_depth\":").integer(int64_t(max_depth.load(std::memory_order_relaxed)));
+    out.raw(",\"queue_capacity\":").integer(int64_t(queue.capacity()));
+    out.raw(",\"queue_full\":").integer(int64_t(queue_full.load(std::memory_order_relaxed)));
+    out.raw(",\"committed\":").integer(int64_t(committed.load(std::memory_order_relaxed)));
+    out.raw(",\"batches\":").integer(int64_t(batches.load(std::memory_order_relaxed)));
+    out.raw("}");
+}
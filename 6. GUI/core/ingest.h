@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "core.h"
+#include "database.h"
+#include "spsc_queue.h"
+
+// Serial-to-database pipeline. The reader thread timestamps and parses
+// lines as they arrive and hands samples to the writer thread through a
+// bounded lock-free queue; the writer commits them in batches. When the
+// queue is full the reader waits and counts the stall. When it is empty the
+// writer sleeps until the reader signals a push.
+class IngestPipeline {
+public:
+    IngestPipeline(SerialPort& port, Database& db, size_t queue_capacity = 4096, size_t max_batch = 256,
+                   std::chrono::milliseconds max_delay = std::chrono::milliseconds(50));
+    ~IngestPipeline();
+    void start();
+    void stop();
+    void wait();
+    void write_stats(JsonWriter& out) const;
+private:
+    void read_loop();
+    void write_loop();
+    void wait_for_samples(std::chrono::steady_clock::time_point deadline);
+    void wake_writer();
+    SerialPort& port;
+    Database& db;
+    SpscQueue<Sample> queue;
+    size_t max_batch;
+    std::chrono::milliseconds max_delay;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> reader_done{false};
+    std::atomic<bool> writer_idle{false};
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<uint64_t> lines{0};
+    std::atomic<uint64_t> parse_errors{0};
+    std::atomic<uint64_t> queue_full{0};
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> max_depth{0};
+    std::thread reader;
+    std::thread writer;
+};
@@ -1,8 +1,10 @@
 #include "database.h"
 #include "web.h"
 #include "core.h"
+#include "ingest.h"
 #include <iostream>
 #include <thread>
+#include <cstdlib>
 
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
@@ -11,9 +13,14 @@ int main(int argc, char* argv[]) {
     std::string port_name = argc > 1 ? argv[1] : "virtual_com";
 #endif
     
-    Database db("weather.db");
-    WebServer server(8080);
-    std::thread server_thread([&]() { server.start(db); });
+    int web_threads = argc > 2 ? std::atoi(argv[2]) : (int)std::thread::hardware_concurrency();
+    if (web_threads < 1) web_threads = 1;
+
+    StorageProfile profile;
+    profile.max_readers = (size_t)web_threads;
+    Database db("weather.db", profile);
+    db.set_retention(RetentionPolicy());
+    WebServer server(8080, web_threads);
     
     SerialPort sp(port_name);
     if (!sp.isOpen()) {
@@ -21,16 +28,11 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    while (true) {
-        std::string data;
-        if (sp.readLine(data) && !data.empty()) {
-            try {
-                double temp = std::stod(data);
-                db.insert_temp(temp);
-            } catch (...) {}
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    }
+    IngestPipeline ingest(sp, db);
+    server.add_stats("ingest", [&](JsonWriter& out) { ingest.write_stats(out); });
+    std::thread server_thread([&]() { server.start(db); });
+    ingest.start();
+    ingest.wait();
     if (server_thread.joinable()) server_thread.join();
     return 0;
 }
\ No newline at end of file
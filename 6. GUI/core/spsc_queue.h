@@ -0,0 +1,49 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded single-producer/single-consumer ring. push() is only called from
+// one thread and pop() from one other thread; neither ever blocks.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : mask(round_up(capacity) - 1), slots(new T[mask + 1]) {}
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head_cache > mask) {
+            head_cache = head.load(std::memory_order_acquire);
+            if (t - head_cache > mask) return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail_cache) {
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (h == tail_cache) return false;
+        }
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    size_t size() const {
+        size_t h = head.load(std::memory_order_acquire);
+        return tail.load(std::memory_order_acquire) - h;
+    }
+    size_t capacity() const { return mask + 1; }
+private:
+    static size_t round_up(size_t n) {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+    const size_t mask;
+    std::unique_ptr<T[]> slots;
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tail_cache = 0;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t head_cache = 0;
+};
@@ -1,53 +1,658 @@
 #include "database.h"
 #include <iostream>
+#include <cstdio>
+#include <algorithm>
 
-Database::Database(const std::string& db_name) {
+static sqlite3_stmt* prepare(sqlite3* db, const char* sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "SQL prepare failed: " << sqlite3_errmsg(db) << std::endl;
+    }
+    return stmt;
+}
+
+static bool run(sqlite3_stmt* stmt) {
+    int rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE || rc == SQLITE_ROW;
+}
+
+static void apply_pragma(sqlite3* db, const std::string& pragma) {
+    std::string sql = "PRAGMA " + pragma + ";";
+    char* err = nullptr;
+    if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+        std::cerr << "PRAGMA " << pragma << " failed: " << (err ? err : "") << std::endl;
+        sqlite3_free(err);
+    }
+}
+
+StorageProfile StorageProfile::rollback() {
+    StorageProfile profile;
+    profile.journal_mode = "DELETE";
+    profile.synchronous = "FULL";
+    profile.mmap_size = 0;
+    profile.cache_size_kb = 2000;
+    return profile;
+}
+
+static const int ROLLUP_RESOLUTIONS[] = {60, 3600, 86400};
+static const int SCHEMA_VERSION = 3;
+
+static void append_row(JsonWriter& out, int64_t time_ms, double temp) {
+    out.raw("{\"time\":", 8).time(time_ms).raw(",\"temp\":", 8).number(temp).raw("}", 1);
+}
+
+Database::Database(const std::string& db_name, const StorageProfile& profile)
+    : hot(profile.hot_cache_samples), path(db_name), storage(profile) {
     sqlite3_open(db_name.c_str(), &db);
-    std::string clean_sql = "DROP TABLE IF EXISTS temp_logs;";
-    sqlite3_exec(db, clean_sql.c_str(), nullptr, nullptr, nullptr);
+    sqlite3_busy_timeout(db, 5000);
+    apply_pragma(db, "page_size = " + std::to_string(profile.page_size));
+    init_schema();
+    apply_pragma(db, "journal_mode = " + profile.journal_mode);
+    apply_pragma(db, "synchronous = " + profile.synchronous);
+    apply_pragma(db, "mmap_size = " + std::to_string(profile.mmap_size));
+    apply_pragma(db, "cache_size = -" + std::to_string(profile.cache_size_kb));
+    insert_stmt = prepare(db, "INSERT INTO temp_logs (ts, temperature) VALUES (?1, ?2)");
+    upsert_rollup_stmt = prepare(db, "INSERT INTO temp_rollups VALUES (?1, ?2, ?3, ?4, ?5, ?6) "
+                                     "ON CONFLICT (resolution, bucket) DO UPDATE SET "
+                                     "min_temp = MIN(min_temp, excluded.min_temp), "
+                                     "max_temp = MAX(max_temp, excluded.max_temp), "
+                                     "sum_temp = sum_temp + excluded.sum_temp, "
+                                     "count = count + excluded.count");
+    prune_raw_stmt = prepare(db, "DELETE FROM temp_logs WHERE id IN "
+                                 "(SELECT id FROM temp_logs WHERE ts < ?2 ORDER BY ts LIMIT ?3)");
+    prune_rollup_stmt = prepare(db, "DELETE FROM temp_rollups WHERE resolution = ?1 AND bucket IN "
+                                    "(SELECT bucket FROM temp_rollups WHERE resolution = ?1 AND bucket < ?2 "
+                                    "ORDER BY bucket LIMIT ?3)");
+    begin_stmt = prepare(db, "BEGIN IMMEDIATE");
+    commit_stmt = prepare(db, "COMMIT");
+    rollback_stmt = prepare(db, "ROLLBACK");
+
+    warm_hot_cache();
+}
+
+void Database::init_schema() {
+    int version = 0;
+    sqlite3_stmt* stmt = prepare(db, "PRAGMA user_version");
+    if (sqlite3_step(stmt) == SQLITE_ROW) version = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    if (version != SCHEMA_VERSION) {
+        sqlite3_exec(db, "DROP TABLE IF EXISTS temp_logs; DROP TABLE IF EXISTS temp_rollups;",
+                     nullptr, nullptr, nullptr);
+        apply_pragma(db, "auto_vacuum = INCREMENTAL");
+        sqlite3_exec(db, "VACUUM", nullptr, nullptr, nullptr);
+    }
     std::string sql = "CREATE TABLE IF NOT EXISTS temp_logs ("
                       "id INTEGER PRIMARY KEY AUTOINCREMENT,"
-                      "timestamp DATETIME DEFAULT CURRENT_TIMESTAMP,"
-                      "temperature REAL);";
+                      "ts INTEGER NOT NULL,"
+                      "temperature REAL);"
+                      "CREATE INDEX IF NOT EXISTS temp_logs_ts ON temp_logs (ts, temperature);"
+                      "CREATE TABLE IF NOT EXISTS temp_rollups ("
+                      "resolution INTEGER NOT NULL,"
+                      "bucket INTEGER NOT NULL,"
+                      "min_temp REAL, max_temp REAL, sum_temp REAL, count INTEGER,"
+                      "PRIMARY KEY (resolution, bucket)) WITHOUT ROWID;"
+                      "PRAGMA user_version = " + std::to_string(SCHEMA_VERSION) + ";";
     sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
 }
 
+Database::Reader* Database::acquire_reader() {
+    std::unique_lock<std::mutex> lock(reader_mutex);
+    while (idle_readers.empty() && readers.size() >= storage.max_readers) reader_cv.wait(lock);
+    if (!idle_readers.empty()) {
+        Reader* r = idle_readers.back();
+        idle_readers.pop_back();
+        return r;
+    }
+    readers.emplace_back(new Reader());
+    Reader* r = readers.back().get();
+    lock.unlock();
+    if (sqlite3_open_v2(path.c_str(), &r->conn, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to open reader connection: " << sqlite3_errmsg(r->conn) << std::endl;
+    }
+    sqlite3_busy_timeout(r->conn, 5000);
+    apply_pragma(r->conn, "mmap_size = " + std::to_string(storage.mmap_size));
+    apply_pragma(r->conn, "cache_size = -" + std::to_string(storage.cache_size_kb));
+    r->current = prepare(r->conn, "SELECT ts, temperature FROM temp_logs ORDER BY ts DESC LIMIT 1");
+    r->history = prepare(r->conn, "SELECT ts, temperature FROM temp_logs WHERE ts >= ?1 ORDER BY ts DESC");
+    r->history_asc = prepare(r->conn, "SELECT ts, temperature FROM temp_logs WHERE ts >= ?1 ORDER BY ts");
+    r->rollup = prepare(r->conn, "SELECT bucket, sum_temp / count, min_temp, max_temp, count FROM temp_rollups "
+                                 "WHERE resolution = ?1 AND bucket >= ?2 ORDER BY bucket DESC");
+    r->rollup_asc = prepare(r->conn, "SELECT bucket, sum_temp / count FROM temp_rollups "
+                                     "WHERE resolution = ?1 AND bucket >= ?2 ORDER BY bucket");
+    r->raw_count = prepare(r->conn, "SELECT COALESCE(SUM(count), 0) FROM temp_rollups "
+                                    "WHERE resolution = 60 AND bucket >= ?1");
+    r->since_id = prepare(r->conn, "SELECT id, ts, temperature FROM temp_logs WHERE id > ?1 AND ts >= ?2 "
+                                   "ORDER BY id LIMIT ?3");
+    r->since_ts = prepare(r->conn, "SELECT id, ts, temperature FROM temp_logs WHERE ts >= ?1 "
+                                   "AND (ts > ?1 OR id > ?2) ORDER BY ts, id LIMIT ?3");
+    r->page = prepare(r->conn, "SELECT id, ts, temperature FROM temp_logs WHERE ts >= ?1 "
+                               "AND (ts < ?2 OR (ts = ?2 AND id < ?3)) ORDER BY ts DESC, id DESC LIMIT ?4");
+    r->page_asc = prepare(r->conn, "SELECT id, ts, temperature FROM temp_logs WHERE ts <= ?1 "
+                                   "AND (ts > ?2 OR (ts = ?2 AND id > ?3)) ORDER BY ts, id LIMIT ?4");
+    return r;
+}
+
+void Database::release_reader(Reader* r) {
+    {
+        std::lock_guard<std::mutex> lock(reader_mutex);
+        idle_readers.push_back(r);
+    }
+    reader_cv.notify_one();
+}
+
+void Database::warm_hot_cache() {
+    ReaderLease r(*this);
+    sqlite3_stmt* stmt = prepare(r->conn, "SELECT ts, temperature FROM "
+                                         "(SELECT ts, temperature FROM temp_logs ORDER BY ts DESC LIMIT ?1) "
+                                         "ORDER BY ts");
+    sqlite3_bind_int64(stmt, 1, int64_t(hot.capacity()) + 1);
+    std::vector<Sample> rows;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        rows.push_back(Sample{sqlite3_column_int64(stmt, 0), sqlite3_column_double(stmt, 1)});
+    }
+    sqlite3_finalize(stmt);
+    for (const Sample& s : rows) hot.push(s);
+    hot.set_complete(rows.size() <= hot.capacity());
+}
+
 Database::~Database() {
+    {
+        std::lock_guard<std::mutex> lock(maintenance_mutex);
+        maintenance_stop = true;
+    }
+    maintenance_cv.notify_all();
+    if (maintenance.joinable()) maintenance.join();
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        stopping = true;
+    }
+    pending_cv.notify_all();
+    if (flusher.joinable()) flusher.join();
+    flush();
+    sqlite3_finalize(insert_stmt);
+    sqlite3_finalize(upsert_rollup_stmt);
+    sqlite3_finalize(begin_stmt);
+    sqlite3_finalize(commit_stmt);
+    sqlite3_finalize(rollback_stmt);
+    sqlite3_finalize(prune_raw_stmt);
+    sqlite3_finalize(prune_rollup_stmt);
+    for (auto& r : readers) {
+        sqlite3_finalize(r->current);
+        sqlite3_finalize(r->history);
+        sqlite3_finalize(r->history_asc);
+        sqlite3_finalize(r->rollup);
+        sqlite3_finalize(r->rollup_asc);
+        sqlite3_finalize(r->raw_count);
+        sqlite3_finalize(r->since_id);
+        sqlite3_finalize(r->since_ts);
+        sqlite3_finalize(r->page);
+        sqlite3_finalize(r->page_asc);
+        sqlite3_close(r->conn);
+    }
     sqlite3_close(db);
 }
 
+int64_t Database::now_ms() {
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+}
+
 void Database::insert_temp(double temp) {
-    std::string sql = "INSERT INTO temp_logs (temperature) VALUES (" + std::to_string(temp) + ");";
-    sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    bool batched;
+    Sample sample{now_ms(), temp};
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (pending.empty()) pending_since = std::chrono::steady_clock::now();
+        pending.push_back(sample);
+        hot.push(sample);
+        batched = pending.size() < commit_batch;
+    }
+    data_generation.fetch_add(1, std::memory_order_release);
+    if (batched) pending_cv.notify_one();
+    else flush();
+    notify(&sample, 1);
+}
+
+void Database::insert_batch(const std::vector<Sample>& samples) {
+    if (samples.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        write_batch(samples.data(), samples.size());
+        for (const Sample& s : samples) hot.push(s);
+    }
+    // Only after the ring has the samples: a response rendered between the
+    // commit and the push must not be cached under the new generation.
+    data_generation.fetch_add(1, std::memory_order_release);
+    notify(samples.data(), samples.size());
+}
+
+void Database::on_insert(std::function<void(const Sample&)> listener) {
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    listeners.push_back(std::move(listener));
+}
+
+void Database::notify(const Sample* samples, size_t count) {
+    std::lock_guard<std::mutex> lock(listener_mutex);
+    for (const auto& listener : listeners) {
+        for (size_t i = 0; i < count; ++i) listener(samples[i]);
+    }
+}
+
+void Database::set_group_commit(size_t max_batch, std::chrono::milliseconds max_delay) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        commit_batch = max_batch > 0 ? max_batch : 1;
+        commit_delay = max_delay;
+    }
+    pending_cv.notify_all();
+    if (commit_batch > 1 && max_delay.count() > 0 && !flusher.joinable()) {
+        flusher = std::thread(&Database::flush_loop, this);
+    }
+}
+
+void Database::flush() {
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    std::vector<Sample> batch;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        batch.swap(pending);
+    }
+    if (!batch.empty() && write_batch(batch.data(), batch.size()))
+        data_generation.fetch_add(1, std::memory_order_release);
+}
+
+void Database::flush_loop() {
+    std::unique_lock<std::mutex> lock(pending_mutex);
+    while (!stopping) {
+        if (pending.empty() || commit_delay.count() <= 0) {
+            pending_cv.wait(lock);
+            continue;
+        }
+        auto deadline = pending_since + commit_delay;
+        if (pending_cv.wait_until(lock, deadline) == std::cv_status::timeout && !pending.empty()
+            && std::chrono::steady_clock::now() >= pending_since + commit_delay) {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+}
+
+void Database::set_retention(const RetentionPolicy& policy) {
+    {
+        std::lock_guard<std::mutex> lock(maintenance_mutex);
+        retention = policy;
+    }
+    maintenance_cv.notify_all();
+    if (!maintenance.joinable()) maintenance = std::thread(&Database::maintenance_loop, this);
+}
+
+void Database::maintenance_loop() {
+    std::unique_lock<std::mutex> lock(maintenance_mutex);
+    while (!maintenance_stop) {
+        lock.unlock();
+        prune();
+        lock.lock();
+        maintenance_cv.wait_for(lock, retention.interval, [this] { return maintenance_stop; });
+    }
+}
+
+int64_t Database::delete_chunk(sqlite3_stmt* stmt, int resolution, int64_t before_ms, int limit) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    sqlite3_bind_int(stmt, 1, resolution);
+    sqlite3_bind_int64(stmt, 2, before_ms);
+    sqlite3_bind_int(stmt, 3, limit);
+    if (!run(stmt)) {
+        std::cerr << "Retention delete failed: " << sqlite3_errmsg(db) << std::endl;
+        return 0;
+    }
+    return sqlite3_changes(db);
+}
+
+void Database::prune() {
+    RetentionPolicy policy;
+    {
+        std::lock_guard<std::mutex> lock(maintenance_mutex);
+        policy = retention;
+    }
+    const int64_t day_ms = 86400000;
+    int64_t now = now_ms();
+    int chunk = policy.chunk_rows > 0 ? policy.chunk_rows : 1000;
+    struct Target { sqlite3_stmt* stmt; int resolution; int days; };
+    const Target targets[] = {
+        {prune_raw_stmt, 0, policy.raw_days},
+        {prune_rollup_stmt, 60, policy.minute_days},
+        {prune_rollup_stmt, 3600, policy.hour_days},
+        {prune_rollup_stmt, 86400, policy.day_days},
+    };
+    int64_t deleted = 0;
+    for (const Target& t : targets) {
+        if (t.days <= 0) continue;
+        int64_t n;
+        do {
+            n = delete_chunk(t.stmt, t.resolution, now - t.days * day_ms, chunk);
+            deleted += n;
+            std::this_thread::yield();
+        } while (n >= chunk);
+    }
+    if (deleted > 0) {
+        data_generation.fetch_add(1, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(write_mutex);
+        apply_pragma(db, "incremental_vacuum(" + std::to_string(policy.vacuum_pages) + ")");
+    }
+}
+
+bool Database::write_batch(const Sample* samples, size_t count) {
+    if (!run(begin_stmt)) {
+        std::cerr << "BEGIN failed: " << sqlite3_errmsg(db) << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        sqlite3_bind_int64(insert_stmt, 1, samples[i].time_ms);
+        sqlite3_bind_double(insert_stmt, 2, samples[i].temp);
+        if (!run(insert_stmt)) {
+            std::cerr << "INSERT failed: " << sqlite3_errmsg(db) << std::endl;
+            run(rollback_stmt);
+            return false;
+        }
+    }
+    if (!write_rollups(samples, count)) {
+        std::cerr << "Rollup update failed: " << sqlite3_errmsg(db) << std::endl;
+        run(rollback_stmt);
+        return false;
+    }
+    if (!run(commit_stmt)) {
+        std::cerr << "COMMIT failed: " << sqlite3_errmsg(db) << std::endl;
+        run(rollback_stmt);
+        return false;
+    }
+    return true;
+}
+
+bool Database::write_rollups(const Sample* samples, size_t count) {
+    for (int resolution : ROLLUP_RESOLUTIONS) {
+        int64_t width = int64_t(resolution) * 1000;
+        size_t i = 0;
+        while (i < count) {
+            int64_t bucket = samples[i].time_ms - ((samples[i].time_ms % width) + width) % width;
+            double lo = samples[i].temp, hi = lo, sum = 0;
+            int64_t n = 0;
+            for (; i < count && samples[i].time_ms >= bucket && samples[i].time_ms < bucket + width; ++i) {
+                lo = std::min(lo, samples[i].temp);
+                hi = std::max(hi, samples[i].temp);
+                sum += samples[i].temp;
+                ++n;
+            }
+            sqlite3_bind_int(upsert_rollup_stmt, 1, resolution);
+            sqlite3_bind_int64(upsert_rollup_stmt, 2, bucket);
+            sqlite3_bind_double(upsert_rollup_stmt, 3, lo);
+            sqlite3_bind_double(upsert_rollup_stmt, 4, hi);
+            sqlite3_bind_double(upsert_rollup_stmt, 5, sum);
+            sqlite3_bind_int64(upsert_rollup_stmt, 6, n);
+            if (!run(upsert_rollup_stmt)) return false;
+        }
+    }
+    return true;
 }
 
 std::string Database::get_current_json() {
-    sqlite3_stmt* stmt;
-    sqlite3_prepare_v2(db, "SELECT temperature, timestamp FROM temp_logs ORDER BY id DESC LIMIT 1", -1, &stmt, nullptr);
-    std::string json = "{}";
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-        json = "{\"temp\":" + std::to_string(sqlite3_column_double(stmt, 0)) + 
-               ", \"time\":\"" + (const char*)sqlite3_column_text(stmt, 1) + "\"}";
+    JsonWriter out;
+    write_current_json(out);
+    return std::move(out.str());
+}
+
+void Database::write_current_json(JsonWriter& out) {
+    Sample latest;
+    bool found = hot.latest(latest);
+    if (!found) {
+        ReaderLease r(*this);
+        if (sqlite3_step(r->current) == SQLITE_ROW) {
+            latest = Sample{sqlite3_column_int64(r->current, 0), sqlite3_column_double(r->current, 1)};
+            found = true;
+        }
+        sqlite3_reset(r->current);
     }
-    sqlite3_finalize(stmt);
-    return json;
+    if (!found) {
+        out.raw("{}", 2);
+        return;
+    }
+    out.raw("{\"temp\":", 8).number(latest.temp).raw(", \"time\":", 9).time(latest.time_ms).raw("}", 1);
+}
+
+int Database::pick_resolution(int64_t from_ms, int seconds, int max_points) {
+    if (max_points <= 0) return 0;
+    if (int64_t(seconds) / 60 <= max_points) {
+        ReaderLease r(*this);
+        sqlite3_bind_int64(r->raw_count, 1, from_ms - from_ms % 60000);
+        int64_t raw = sqlite3_step(r->raw_count) == SQLITE_ROW ? sqlite3_column_int64(r->raw_count, 0) : 0;
+        sqlite3_reset(r->raw_count);
+        if (raw <= max_points) return 0;
+    }
+    for (int resolution : ROLLUP_RESOLUTIONS) {
+        if ((int64_t(seconds) + resolution - 1) / resolution <= max_points) return resolution;
+    }
+    return ROLLUP_RESOLUTIONS[2];
 }
 
-std::string Database::get_history_json(int seconds) {
-    sqlite3_stmt* stmt;
-    std::string sql = "SELECT timestamp, temperature FROM temp_logs "
-                      "WHERE timestamp >= datetime('now', '-" + std::to_string(seconds) + " seconds') "
-                      "ORDER BY id DESC";
-    sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr);
-    std::string json = "[";
+void Database::write_rollup_json(JsonWriter& out, int resolution, int64_t from_ms) {
+    int64_t width = int64_t(resolution) * 1000;
+    ReaderLease r(*this);
+    sqlite3_bind_int(r->rollup, 1, resolution);
+    sqlite3_bind_int64(r->rollup, 2, from_ms - ((from_ms % width) + width) % width);
+    out.raw("[", 1);
     bool first = true;
+    while (sqlite3_step(r->rollup) == SQLITE_ROW) {
+        if (!first) out.raw(",", 1);
+        out.raw("{\"time\":", 8).time(sqlite3_column_int64(r->rollup, 0));
+        out.raw(",\"temp\":", 8).number(sqlite3_column_double(r->rollup, 1));
+        out.raw(",\"min\":", 7).number(sqlite3_column_double(r->rollup, 2));
+        out.raw(",\"max\":", 7).number(sqlite3_column_double(r->rollup, 3));
+        out.raw(",\"count\":", 9).integer(sqlite3_column_int64(r->rollup, 4)).raw("}", 1);
+        first = false;
+    }
+    out.raw("]", 1);
+    sqlite3_reset(r->rollup);
+}
+
+void Database::scan_history(int64_t from_ms, const std::function<void(const Sample&)>& fn, bool ascending) {
+    std::vector<Sample> recent;
+    if (hot.collect_since(from_ms, recent)) {
+        if (ascending) {
+            for (auto it = recent.rbegin(); it != recent.rend(); ++it) fn(*it);
+        } else {
+            for (const Sample& s : recent) fn(s);
+        }
+        return;
+    }
+    ReaderLease r(*this);
+    sqlite3_stmt* stmt = ascending ? r->history_asc : r->history;
+    sqlite3_bind_int64(stmt, 1, from_ms);
     while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (!first) json += ",";
-        json += "{\"time\":\"" + std::string((const char*)sqlite3_column_text(stmt, 0)) + "\",";
-        json += "\"temp\":" + std::to_string(sqlite3_column_double(stmt, 1)) + "}";
+        fn(Sample{sqlite3_column_int64(stmt, 0), sqlite3_column_double(stmt, 1)});
+    }
+    sqlite3_reset(stmt);
+}
+
+void Database::scan_rollups(int resolution, int64_t from_ms, const std::function<void(const Sample&)>& fn) {
+    int64_t width = int64_t(resolution) * 1000;
+    ReaderLease r(*this);
+    sqlite3_bind_int(r->rollup_asc, 1, resolution);
+    sqlite3_bind_int64(r->rollup_asc, 2, from_ms - ((from_ms % width) + width) % width);
+    while (sqlite3_step(r->rollup_asc) == SQLITE_ROW) {
+        fn(Sample{sqlite3_column_int64(r->rollup_asc, 0), sqlite3_column_double(r->rollup_asc, 1)});
+    }
+    sqlite3_reset(r->rollup_asc);
+}
+
+// Cursor reads for clients that already hold the window: rows newer than
+// since_id alone (rowid range) or after (since_ts, since_id) in (ts, id)
+// order (ts index), oldest first, never older than the window. Rows still
+// waiting for a group commit show up on the next call.
+//
+// A client that sends since_ts without since_id only knows the timestamp it
+// stopped at, so such a page never ends inside a run of equal timestamps:
+// one extra row is read and the run it belongs to is left for the next call.
+// Only a run longer than the whole limit is still cut.
+void Database::scan_since(int seconds, int64_t since_id, int64_t since_ts, int limit,
+                          const std::function<void(int64_t, const Sample&)>& fn) {
+    int64_t from_ms = now_ms() - int64_t(seconds) * 1000;
+    std::vector<std::pair<int64_t, Sample>> rows;
+    bool whole_runs = since_ts >= 0 && since_id < 0;
+    {
+        ReaderLease r(*this);
+        sqlite3_stmt* stmt;
+        if (since_ts < 0) {
+            stmt = r->since_id;
+            sqlite3_bind_int64(stmt, 1, since_id);
+            sqlite3_bind_int64(stmt, 2, from_ms);
+            sqlite3_bind_int(stmt, 3, limit);
+        } else {
+            stmt = r->since_ts;
+            bool in_window = since_ts >= from_ms;
+            sqlite3_bind_int64(stmt, 1, in_window ? since_ts : from_ms - 1);
+            sqlite3_bind_int64(stmt, 2, in_window && since_id >= 0 ? since_id : INT64_MAX);
+            sqlite3_bind_int(stmt, 3, whole_runs ? limit + 1 : limit);
+        }
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            rows.emplace_back(sqlite3_column_int64(stmt, 0),
+                              Sample{sqlite3_column_int64(stmt, 1), sqlite3_column_double(stmt, 2)});
+        }
+        sqlite3_reset(stmt);
+    }
+    if (whole_runs && rows.size() > size_t(limit)) {
+        int64_t cut_ms = rows.back().second.time_ms;
+        size_t end = rows.size() - 1;
+        while (end > 0 && rows[end - 1].second.time_ms == cut_ms) --end;
+        rows.resize(end > 0 ? end : size_t(limit));
+    }
+    for (const auto& row : rows) fn(row.first, row.second);
+}
+
+void Database::write_history_since_json(JsonWriter& out, int seconds, int64_t since_id, int64_t since_ts, int limit) {
+    bool first = true;
+    out.raw("[", 1);
+    scan_since(seconds, since_id, since_ts, limit, [&](int64_t id, const Sample& s) {
+        out.raw(first ? "{\"id\":" : ",{\"id\":", first ? 6 : 7).integer(id);
+        out.raw(",\"time\":", 8).time(s.time_ms).raw(",\"temp\":", 8).number(s.temp).raw("}", 1);
         first = false;
+    });
+    out.raw("]", 1);
+}
+
+void Database::write_history_since_binary(HistoryBlockWriter& out, int seconds, int64_t since_id, int64_t since_ts,
+                                          int limit) {
+    scan_since(seconds, since_id, since_ts, limit, [&](int64_t, const Sample& s) { out.add(s); });
+    out.finish();
+}
+
+HistoryCursor Database::open_history_cursor(int seconds, bool ascending) {
+    HistoryCursor cursor;
+    cursor.to_ms = now_ms();
+    cursor.from_ms = cursor.to_ms - int64_t(seconds) * 1000;
+    cursor.ascending = ascending;
+    cursor.ts = ascending ? cursor.from_ms : cursor.to_ms;
+    cursor.id = ascending ? -1 : INT64_MAX;
+    return cursor;
+}
+
+// One page of the window per call; the hot cache answers the whole window at
+// once when it covers it. Rows inserted after the cursor was opened are left out.
+void Database::scan_page(HistoryCursor& cursor, int limit, const std::function<void(const Sample&)>& fn) {
+    if (!cursor.started) {
+        std::vector<Sample> recent;
+        if (hot.collect_since(cursor.from_ms, recent)) {
+            auto visit = [&](const Sample& s) { if (s.time_ms <= cursor.to_ms) fn(s); };
+            if (cursor.ascending) {
+                for (auto it = recent.rbegin(); it != recent.rend(); ++it) visit(*it);
+            } else {
+                for (const Sample& s : recent) visit(s);
+            }
+            cursor.done = true;
+            return;
+        }
     }
-    json += "]";
-    sqlite3_finalize(stmt);
-    return json;
-}
\ No newline at end of file
+    ReaderLease r(*this);
+    sqlite3_stmt* stmt = cursor.ascending ? r->page_asc : r->page;
+    sqlite3_bind_int64(stmt, 1, cursor.ascending ? cursor.to_ms : cursor.from_ms);
+    sqlite3_bind_int64(stmt, 2, cursor.ts);
+    sqlite3_bind_int64(stmt, 3, cursor.id);
+    sqlite3_bind_int(stmt, 4, limit);
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        cursor.id = sqlite3_column_int64(stmt, 0);
+        cursor.ts = sqlite3_column_int64(stmt, 1);
+        fn(Sample{cursor.ts, sqlite3_column_double(stmt, 2)});
+        ++rows;
+    }
+    sqlite3_reset(stmt);
+    if (rows < limit) cursor.done = true;
+}
+
+void Database::write_history_page_json(JsonWriter& out, HistoryCursor& cursor, int limit) {
+    // Every page before the last is full, so later pages always need a comma
+    bool comma = cursor.started;
+    if (!cursor.started) out.raw("[", 1);
+    scan_page(cursor, limit, [&](const Sample& s) {
+        if (comma) out.raw(",", 1);
+        append_row(out, s.time_ms, s.temp);
+        comma = true;
+    });
+    cursor.started = true;
+    if (cursor.done) out.raw("]", 1);
+}
+
+void Database::write_history_page_binary(HistoryBlockWriter& out, HistoryCursor& cursor, int limit) {
+    scan_page(cursor, limit, [&](const Sample& s) { out.add(s); });
+    cursor.started = true;
+    if (cursor.done) out.finish();
+}
+
+std::string Database::get_history_json(int seconds, int max_points, DownsampleMode mode) {
+    JsonWriter out;
+    write_history_json(out, seconds, max_points, mode);
+    return std::move(out.str());
+}
+
+void Database::write_history_json(JsonWriter& out, int seconds, int max_points, DownsampleMode mode) {
+    int64_t to_ms = now_ms();
+    int64_t from_ms = to_ms - int64_t(seconds) * 1000;
+    bool first = true;
+    auto emit = [&](const Sample& s) {
+        if (!first) out.raw(",", 1);
+        append_row(out, s.time_ms, s.temp);
+        first = false;
+    };
+    if (max_points > 0 && mode != DownsampleMode::Rollup) {
+        Downsampler sampler(mode, from_ms, to_ms, max_points);
+        scan_history(from_ms, [&](const Sample& s) { sampler.add(s); });
+        out.raw("[", 1);
+        for (const Sample& s : sampler.finish()) emit(s);
+        out.raw("]", 1);
+        return;
+    }
+    int resolution = pick_resolution(from_ms, seconds, max_points);
+    if (resolution > 0) {
+        write_rollup_json(out, resolution, from_ms);
+        return;
+    }
+    out.raw("[", 1);
+    scan_history(from_ms, emit);
+    out.raw("]", 1);
+}
+
+void Database::write_history_binary(HistoryBlockWriter& out, int seconds, int max_points, DownsampleMode mode) {
+    int64_t to_ms = now_ms();
+    int64_t from_ms = to_ms - int64_t(seconds) * 1000;
+    auto emit = [&](const Sample& s) { out.add(s); };
+    if (max_points > 0 && mode != DownsampleMode::Rollup) {
+        Downsampler sampler(mode, from_ms, to_ms, max_points);
+        scan_history(from_ms, [&](const Sample& s) { sampler.add(s); }, true);
+        for (const Sample& s : sampler.finish()) out.add(s);
+    } else if (int resolution = pick_resolution(from_ms, seconds, max_points)) {
+        scan_rollups(resolution, from_ms, emit);
+    } else {
+        scan_history(from_ms, emit, true);
+    }
+    out.finish();
+}
@@ -1,15 +1,150 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <memory>
 #include "sqlite3.h"
+#include "sample_ring.h"
+#include "downsample.h"
+#include "json_writer.h"
+#include "history_codec.h"
+
+struct StorageProfile {
+    std::string journal_mode = "WAL";
+    std::string synchronous = "NORMAL";
+    int64_t mmap_size = 256ll << 20;
+    int cache_size_kb = 16 * 1024;
+    int page_size = 4096;
+    size_t hot_cache_samples = 4096;
+    size_t max_readers = 8;
+    static StorageProfile rollback();
+};
+
+struct RetentionPolicy {
+    int raw_days = 7;
+    int minute_days = 30;
+    int hour_days = 365;
+    int day_days = 0;
+    int chunk_rows = 2000;
+    int vacuum_pages = 512;
+    std::chrono::seconds interval{60};
+};
+
+// Position in a raw history scan that is written out one page at a time.
+// Rows are ordered by (ts, id) so pages resume exactly where the last one ended.
+struct HistoryCursor {
+    int64_t from_ms = 0;
+    int64_t to_ms = 0;
+    int64_t ts = 0;
+    int64_t id = 0;
+    bool ascending = false;
+    bool started = false;
+    bool done = false;
+};
 
 class Database {
 public:
-    Database(const std::string& db_name);
+    Database(const std::string& db_name, const StorageProfile& profile = StorageProfile());
     ~Database();
     void insert_temp(double temp);
+    void insert_batch(const std::vector<Sample>& samples);
+    void set_group_commit(size_t max_batch, std::chrono::milliseconds max_delay);
+    void flush();
+    void on_insert(std::function<void(const Sample&)> listener);
+    // Bumped whenever query results may change: insert, commit, prune.
+    uint64_t generation() const { return data_generation.load(std::memory_order_acquire); }
+    void set_retention(const RetentionPolicy& policy);
+    void prune();
     std::string get_current_json();
-    std::string get_history_json(int seconds);
+    std::string get_history_json(int seconds, int max_points = 0, DownsampleMode mode = DownsampleMode::Rollup);
+    void write_current_json(JsonWriter& out);
+    void write_history_json(JsonWriter& out, int seconds, int max_points = 0,
+                            DownsampleMode mode = DownsampleMode::Rollup);
+    void write_history_binary(HistoryBlockWriter& out, int seconds, int max_points = 0,
+                              DownsampleMode mode = DownsampleMode::Rollup);
+    void write_history_since_json(JsonWriter& out, int seconds, int64_t since_id, int64_t since_ts, int limit);
+    void write_history_since_binary(HistoryBlockWriter& out, int seconds, int64_t since_id, int64_t since_ts,
+                                    int limit);
+    HistoryCursor open_history_cursor(int seconds, bool ascending);
+    void write_history_page_json(JsonWriter& out, HistoryCursor& cursor, int limit);
+    void write_history_page_binary(HistoryBlockWriter& out, HistoryCursor& cursor, int limit);
+    static int64_t now_ms();
 private:
+    struct Reader {
+        sqlite3* conn = nullptr;
+        sqlite3_stmt* current = nullptr;
+        sqlite3_stmt* history = nullptr;
+        sqlite3_stmt* history_asc = nullptr;
+        sqlite3_stmt* rollup = nullptr;
+        sqlite3_stmt* rollup_asc = nullptr;
+        sqlite3_stmt* raw_count = nullptr;
+        sqlite3_stmt* since_id = nullptr;
+        sqlite3_stmt* since_ts = nullptr;
+        sqlite3_stmt* page = nullptr;
+        sqlite3_stmt* page_asc = nullptr;
+    };
+    class ReaderLease {
+    public:
+        explicit ReaderLease(Database& db) : db(db), reader(db.acquire_reader()) {}
+        ~ReaderLease() { db.release_reader(reader); }
+        Reader* operator->() const { return reader; }
+    private:
+        Database& db;
+        Reader* reader;
+    };
+    Reader* acquire_reader();
+    void release_reader(Reader* r);
+    bool write_batch(const Sample* samples, size_t count);
+    void notify(const Sample* samples, size_t count);
+    void flush_loop();
+    void init_schema();
+    void warm_hot_cache();
+    void maintenance_loop();
+    int64_t delete_chunk(sqlite3_stmt* stmt, int resolution, int64_t before_ms, int limit);
+    bool write_rollups(const Sample* samples, size_t count);
+    int pick_resolution(int64_t from_ms, int seconds, int max_points);
+    void write_rollup_json(JsonWriter& out, int resolution, int64_t from_ms);
+    void scan_history(int64_t from_ms, const std::function<void(const Sample&)>& fn, bool ascending = false);
+    void scan_rollups(int resolution, int64_t from_ms, const std::function<void(const Sample&)>& fn);
+    void scan_since(int seconds, int64_t since_id, int64_t since_ts, int limit,
+                    const std::function<void(int64_t, const Sample&)>& fn);
+    void scan_page(HistoryCursor& cursor, int limit, const std::function<void(const Sample&)>& fn);
+    SampleRing hot;
+    std::string path;
+    StorageProfile storage;
     sqlite3* db;
-};
\ No newline at end of file
+    std::mutex reader_mutex;
+    std::condition_variable reader_cv;
+    std::vector<std::unique_ptr<Reader>> readers;
+    std::vector<Reader*> idle_readers;
+    sqlite3_stmt* insert_stmt = nullptr;
+    sqlite3_stmt* upsert_rollup_stmt = nullptr;
+    sqlite3_stmt* begin_stmt = nullptr;
+    sqlite3_stmt* commit_stmt = nullptr;
+    sqlite3_stmt* rollback_stmt = nullptr;
+    sqlite3_stmt* prune_raw_stmt = nullptr;
+    sqlite3_stmt* prune_rollup_stmt = nullptr;
+    std::atomic<uint64_t> data_generation{0};
+    std::mutex listener_mutex;
+    std::vector<std::function<void(const Sample&)>> listeners;
+    std::mutex write_mutex;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    std::vector<Sample> pending;
+    std::chrono::steady_clock::time_point pending_since;
+    size_t commit_batch = 1;
+    std::chrono::milliseconds commit_delay{0};
+    bool stopping = false;
+    std::thread flusher;
+    std::mutex maintenance_mutex;
+    std::condition_variable maintenance_cv;
+    RetentionPolicy retention;
+    bool maintenance_stop = false;
+    std::thread maintenance;
+};
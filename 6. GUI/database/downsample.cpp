@@ -0,0 +1,111 @@
+#include "downsample.h"
+#include <algorithm>
+#include <cmath>
+
+bool parse_downsample_mode(const std::string& name, DownsampleMode& mode) {
+    if (name == "rollup") mode = DownsampleMode::Rollup;
+    else if (name == "lttb") mode = DownsampleMode::Lttb;
+    else if (name == "minmax") mode = DownsampleMode::MinMax;
+    else if (name == "avg") mode = DownsampleMode::Avg;
+    else return false;
+    return true;
+}
+
+Downsampler::Downsampler(DownsampleMode mode, int64_t from_ms, int64_t to_ms, int max_points)
+    : mode(mode), from_ms(from_ms) {
+    int64_t buckets = std::max(1, mode == DownsampleMode::MinMax ? max_points / 2 : max_points);
+    if (mode == DownsampleMode::Lttb) buckets = std::max<int64_t>(1, buckets - 2);
+    width_ms = std::max<int64_t>(1, (to_ms - from_ms + buckets - 1) / buckets);
+    out.reserve(max_points > 0 ? max_points : 0);
+}
+
+int64_t Downsampler::bucket_of(int64_t time_ms) const {
+    return (time_ms - from_ms) / width_ms;
+}
+
+void Downsampler::add(const Sample& sample) {
+    if (mode == DownsampleMode::Lttb && !have_anchor) {
+        anchor = sample;
+        have_anchor = true;
+        out.push_back(sample);
+        return;
+    }
+    int64_t index = bucket_of(sample.time_ms);
+    if (index != current.index && !current.points.empty()) close_bucket();
+    current.index = index;
+    if (current.points.empty() || sample.temp < current.points[current.min_pos].temp) current.min_pos = current.points.size();
+    if (current.points.empty() || sample.temp > current.points[current.max_pos].temp) current.max_pos = current.points.size();
+    current.points.push_back(sample);
+    current.sum_time += double(sample.time_ms);
+    current.sum_temp += sample.temp;
+}
+
+void Downsampler::close_bucket() {
+    switch (mode) {
+    case DownsampleMode::Lttb:
+        if (have_previous) {
+            emit_lttb(previous, current.sum_time / current.points.size(), current.sum_temp / current.points.size());
+        }
+        std::swap(previous, current);
+        have_previous = true;
+        break;
+    case DownsampleMode::MinMax: {
+        size_t a = std::min(current.min_pos, current.max_pos), b = std::max(current.min_pos, current.max_pos);
+        out.push_back(current.points[a]);
+        if (b != a) out.push_back(current.points[b]);
+        break;
+    }
+    case DownsampleMode::Avg:
+    case DownsampleMode::Rollup: {
+        double n = double(current.points.size());
+        out.push_back(Sample{int64_t(current.sum_time / n), current.sum_temp / n});
+        break;
+    }
+    }
+    current.points.clear();
+    current.sum_time = current.sum_temp = 0;
+    current.min_pos = current.max_pos = 0;
+}
+
+void Downsampler::emit_lttb(const Bucket& bucket, double next_time, double next_temp) {
+    double best_area = -1;
+    size_t best = 0;
+    double ax = double(anchor.time_ms), ay = anchor.temp;
+    for (size_t i = 0; i < bucket.points.size(); ++i) {
+        double bx = double(bucket.points[i].time_ms), by = bucket.points[i].temp;
+        double area = std::fabs((ax - next_time) * (by - ay) - (ax - bx) * (next_temp - ay));
+        if (area > best_area) {
+            best_area = area;
+            best = i;
+        }
+    }
+    anchor = bucket.points[best];
+    out.push_back(anchor);
+}
+
+const std::vector<Sample>& Downsampler::finish() {
+    if (mode != DownsampleMode::Lttb) {
+        if (!current.points.empty()) close_bucket();
+        return out;
+    }
+    if (current.points.empty()) {
+        if (have_previous && !previous.points.empty()) {
+            Sample last = previous.points.back();
+            previous.points.pop_back();
+            if (!previous.points.empty()) emit_lttb(previous, double(last.time_ms), last.temp);
+            out.push_back(last);
+        }
+        return out;
+    }
+    Sample last = current.points.back();
+    current.points.pop_back();
+    if (have_previous) {
+        if (current.points.empty()) emit_lttb(previous, double(last.time_ms), last.temp);
+        else emit_lttb(previous, current.sum_time / (current.points.size() + 1), current.sum_temp / (current.points.size() + 1));
+    }
+    if (!current.points.empty()) emit_lttb(current, double(last.time_ms), last.temp);
+    out.push_back(last);
+    have_previous = false;
+    current.points.clear();
+    return out;
+}
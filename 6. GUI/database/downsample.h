@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "sample_ring.h"
+
+enum class DownsampleMode { Rollup, Lttb, MinMax, Avg };
+
+bool parse_downsample_mode(const std::string& name, DownsampleMode& mode);
+
+// Single-pass downsampler over a time-ordered stream (either direction).
+// The window is split into equal time buckets; only the current and the
+// previous bucket are kept in memory.
+class Downsampler {
+public:
+    Downsampler(DownsampleMode mode, int64_t from_ms, int64_t to_ms, int max_points);
+    void add(const Sample& sample);
+    const std::vector<Sample>& finish();
+private:
+    struct Bucket {
+        int64_t index = -1;
+        std::vector<Sample> points;
+        double sum_time = 0, sum_temp = 0;
+        size_t min_pos = 0, max_pos = 0;
+    };
+    int64_t bucket_of(int64_t time_ms) const;
+    void close_bucket();
+    void emit_lttb(const Bucket& bucket, double next_time, double next_temp);
+    DownsampleMode mode;
+    int64_t from_ms;
+    int64_t width_ms;
+    Bucket current, previous;
+    bool have_previous = false;
+    bool have_anchor = false;
+    Sample anchor{};
+    std::vector<Sample> out;
+};
@@ -0,0 +1,53 @@
+#include "history_codec.h"
+#include <cstring>
+#include <limits>
+
+static void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(char((value >> (8 * i)) & 0xff));
+}
+
+HistoryBlockWriter::HistoryBlockWriter(JsonWriter::Sink sink, size_t block_rows)
+    : sink(std::move(sink)), block_rows(block_rows ? block_rows : 1) {
+    buffer.reserve(block_rows * 12 + 16);
+    times.reserve(block_rows * 4 + 8);
+    temps.reserve(block_rows * 4);
+    buffer.append("WHB1", 4);
+}
+
+void HistoryBlockWriter::add(const Sample& sample) {
+    int64_t delta = sample.time_ms - last_ms;
+    if (count > 0 && (delta < std::numeric_limits<int32_t>::min() || delta > std::numeric_limits<int32_t>::max())) {
+        close_block();
+    }
+    if (count == 0) put_le(times, uint64_t(sample.time_ms), 8);
+    else put_le(times, uint32_t(int32_t(delta)), 4);
+    float temp = float(sample.temp);
+    uint32_t bits;
+    std::memcpy(&bits, &temp, sizeof(bits));
+    put_le(temps, bits, 4);
+    last_ms = sample.time_ms;
+    if (++count == block_rows) close_block();
+}
+
+void HistoryBlockWriter::close_block() {
+    if (count == 0) return;
+    put_le(buffer, uint32_t(count), 4);
+    buffer += times;
+    buffer += temps;
+    times.clear();
+    temps.clear();
+    count = 0;
+    if (sink) {
+        sink(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
+
+void HistoryBlockWriter::finish() {
+    close_block();
+    put_le(buffer, 0, 4);
+    if (sink) {
+        sink(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "json_writer.h"
+#include "sample_ring.h"
+
+// Binary history stream served as /api/history.bin, little-endian:
+//   "WHB1"
+//   block*: uint32 n (n > 0), int64 first_ms, int32 delta_ms[n - 1], float32 temp[n]
+//   uint32 0
+// Samples are in ascending time order.
+class HistoryBlockWriter {
+public:
+    explicit HistoryBlockWriter(JsonWriter::Sink sink, size_t block_rows = 1024);
+    void add(const Sample& sample);
+    void finish();
+    std::string& str() { return buffer; }
+private:
+    void close_block();
+    JsonWriter::Sink sink;
+    size_t block_rows;
+    std::string buffer;
+    std::string times;
+    std::string temps;
+    size_t count = 0;
+    int64_t last_ms = 0;
+};
@@ -0,0 +1,102 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+static int64_t floor_div(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : (a - b + 1) / b;
+}
+
+static void put2(char* out, int value) {
+    out[0] = char('0' + value / 10);
+    out[1] = char('0' + value % 10);
+}
+
+static void format_date(int64_t days, char out[10]) {
+    // civil_from_days (H. Hinnant)
+    int64_t z = days + 719468;
+    int64_t era = floor_div(z, 146097);
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int d = int(doy - (153 * mp + 2) / 5 + 1);
+    int m = int(mp < 10 ? mp + 3 : mp - 9);
+    int y = int(yoe + era * 400 + (m <= 2));
+    put2(out, y / 100 % 100);
+    put2(out + 2, y % 100);
+    out[4] = '-';
+    put2(out + 5, m);
+    out[7] = '-';
+    put2(out + 8, d);
+}
+
+static void format_clock(int64_t seconds_of_day, char out[8]) {
+    int sod = int(seconds_of_day);
+    put2(out, sod / 3600);
+    out[2] = ':';
+    put2(out + 3, sod / 60 % 60);
+    out[5] = ':';
+    put2(out + 6, sod % 60);
+}
+
+JsonWriter::JsonWriter(Sink sink, size_t chunk_size) : sink(std::move(sink)), chunk_size(chunk_size) {
+    buffer.reserve(chunk_size + 256);
+}
+
+void JsonWriter::format_time(int64_t time_ms, char out[19]) {
+    int64_t secs = floor_div(time_ms, 1000);
+    int64_t days = floor_div(secs, 86400);
+    format_date(days, out);
+    out[10] = ' ';
+    format_clock(secs - days * 86400, out + 11);
+}
+
+JsonWriter& JsonWriter::raw(const char* data, size_t size) {
+    buffer.append(data, size);
+    maybe_flush();
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const char* text) {
+    return raw(text, std::strlen(text));
+}
+
+JsonWriter& JsonWriter::number(double value) {
+    if (!std::isfinite(value)) return raw("null", 4);
+    char tmp[32];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+    return raw(tmp, size_t(res.ptr - tmp));
+}
+
+JsonWriter& JsonWriter::integer(int64_t value) {
+    char tmp[24];
+    auto res = std::to_chars(tmp, tmp + sizeof(tmp), value);
+    return raw(tmp, size_t(res.ptr - tmp));
+}
+
+JsonWriter& JsonWriter::time(int64_t time_ms) {
+    int64_t secs = floor_div(time_ms, 1000);
+    int64_t days = floor_div(secs, 86400);
+    if (days != cached_day) {
+        format_date(days, cached_date);
+        cached_date[10] = ' ';
+        cached_day = days;
+    }
+    char tmp[21];
+    tmp[0] = '"';
+    std::memcpy(tmp + 1, cached_date, 11);
+    format_clock(secs - days * 86400, tmp + 12);
+    tmp[20] = '"';
+    return raw(tmp, sizeof(tmp));
+}
+
+void JsonWriter::maybe_flush() {
+    if (sink && buffer.size() >= chunk_size) flush();
+}
+
+void JsonWriter::flush() {
+    if (!sink || buffer.empty()) return;
+    sink(buffer.data(), buffer.size());
+    buffer.clear();
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Appends JSON into one reusable buffer. With a sink, the buffer is handed
+// over every time it grows past chunk_size, so large bodies never have to
+// be materialized as a whole.
+class JsonWriter {
+public:
+    using Sink = std::function<void(const char* data, size_t size)>;
+    explicit JsonWriter(Sink sink = nullptr, size_t chunk_size = 16 * 1024);
+    JsonWriter& raw(const char* data, size_t size);
+    JsonWriter& raw(const char* text);
+    JsonWriter& number(double value);
+    JsonWriter& integer(int64_t value);
+    JsonWriter& time(int64_t time_ms);
+    void flush();
+    std::string& str() { return buffer; }
+    static void format_time(int64_t time_ms, char out[19]);
+private:
+    void maybe_flush();
+    Sink sink;
+    size_t chunk_size;
+    std::string buffer;
+    int64_t cached_day = INT64_MIN;
+    char cached_date[11];
+};
@@ -0,0 +1,42 @@
+#include "sample_ring.h"
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+SampleRing::SampleRing(size_t capacity)
+    : slots(new Sample[round_up_pow2(capacity ? capacity : 1)]),
+      mask(round_up_pow2(capacity ? capacity : 1) - 1) {}
+
+void SampleRing::push(const Sample& sample) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head > mask) complete = false;
+    slots[head & mask] = sample;
+    ++head;
+}
+
+void SampleRing::set_complete(bool value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    complete = value;
+}
+
+bool SampleRing::latest(Sample& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (head == 0) return false;
+    out = slots[(head - 1) & mask];
+    return true;
+}
+
+bool SampleRing::collect_since(int64_t from_ms, std::vector<Sample>& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t tail = head > mask ? head - mask - 1 : 0;
+    if (!complete && (head == tail || slots[tail & mask].time_ms > from_ms)) return false;
+    for (uint64_t i = head; i > tail; --i) {
+        const Sample& s = slots[(i - 1) & mask];
+        if (s.time_ms < from_ms) break;
+        out.push_back(s);
+    }
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct Sample {
+    int64_t time_ms;
+    double temp;
+};
+
+class SampleRing {
+public:
+    explicit SampleRing(size_t capacity);
+    void push(const Sample& sample);
+    void set_complete(bool value);
+    bool latest(Sample& out) const;
+    bool collect_since(int64_t from_ms, std::vector<Sample>& out) const;
+    size_t capacity() const { return mask + 1; }
+private:
+    std::unique_ptr<Sample[]> slots;
+    size_t mask;
+    alignas(64) uint64_t head = 0;
+    bool complete = true;
+    mutable std::mutex mutex;
+};
@@ -1,11 +1,38 @@
 #include "gui.h"
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QJsonArray>
 #include <QDateTime>
-#include <QTimeZone>
 #include <QNetworkReply>
-#include <algorithm>
+#include <QtEndian>
+#include <cstring>
+
+static const int HISTORY_MAX_POINTS = 1000;
+
+static bool decodeHistoryBlocks(const QByteArray &data, QList<QPointF> &points) {
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+    const uchar *end = p + data.size();
+    if (end - p < 4 || std::memcmp(p, "WHB1", 4) != 0) return false;
+    p += 4;
+    while (end - p >= 4) {
+        quint32 n = qFromLittleEndian<quint32>(p);
+        p += 4;
+        if (n == 0) return true;
+        if (quint64(end - p) < 8 + 4 * quint64(n - 1) + 4 * quint64(n)) return false;
+        const uchar *deltas = p + 8;
+        const uchar *temps = deltas + 4 * (n - 1);
+        qint64 t = qFromLittleEndian<qint64>(p);
+        points.reserve(points.size() + n);
+        for (quint32 i = 0; i < n; ++i) {
+            if (i > 0) t += qFromLittleEndian<qint32>(deltas + 4 * (i - 1));
+            quint32 bits = qFromLittleEndian<quint32>(temps + 4 * i);
+            float temp;
+            std::memcpy(&temp, &bits, sizeof(temp));
+            points.append(QPointF(double(t), temp));
+        }
+        p = temps + 4 * n;
+    }
+    return false;
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), currentPeriodSeconds(60) {
     setupUi();
@@ -13,12 +40,21 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), currentPeriodSeco
     refreshTimer = new QTimer(this);
     connect(refreshTimer, &QTimer::timeout, this, &MainWindow::updateCurrentData);
     connect(refreshTimer, &QTimer::timeout, this, &MainWindow::updateHistoryData);
-    refreshTimer->start(1000);
+    liveSocket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    connect(liveSocket, &QWebSocket::connected, this, &MainWindow::onSocketConnected);
+    connect(liveSocket, &QWebSocket::stateChanged, this, [this](QAbstractSocket::SocketState state) {
+        if (state == QAbstractSocket::UnconnectedState) onSocketDisconnected();
+    });
+    connect(liveSocket, &QWebSocket::binaryMessageReceived, this, &MainWindow::onSocketMessage);
     updateCurrentData();
-    updateHistoryData();
+    reloadHistory();
+    refreshTimer->start(1000);
+    liveSocket->open(QUrl("ws://localhost:8080/api/ws"));
 }
 
-MainWindow::~MainWindow() {}
+MainWindow::~MainWindow() {
+    liveSocket->disconnect(this);
+}
 
 void MainWindow::setupUi() {
     QWidget *centralWidget = new QWidget(this);
@@ -33,8 +69,11 @@ void MainWindow::setupUi() {
     currentTempLabel->setFont(fontCurr);
     averageTempLabel = new QLabel("Avg (Period): -- °C");
     averageTempLabel->setStyleSheet("color: #666;");
+    windowStatsLabel = new QLabel("Last minute: --");
+    windowStatsLabel->setStyleSheet("color: #666;");
     tempLayout->addWidget(currentTempLabel);
     tempLayout->addWidget(averageTempLabel);
+    tempLayout->addWidget(windowStatsLabel);
     lastUpdateLabel = new QLabel("Last update: --");
     topLayout->addLayout(tempLayout);
     topLayout->addStretch();
@@ -78,7 +117,7 @@ void MainWindow::onPeriodChanged(int seconds) {
     currentPeriodSeconds = seconds;
     if (seconds > 3600) axisX->setFormat("HH:mm"); 
     else axisX->setFormat("HH:mm:ss");
-    updateHistoryData();
+    reloadHistory();
 }
 
 void MainWindow::updateCurrentData() {
@@ -87,11 +126,29 @@ void MainWindow::updateCurrentData() {
     connect(reply, &QNetworkReply::finished, this, [this, reply](){ onCurrentDataReceived(reply); });
 }
 
+// Once a window is loaded, refreshes only ask for rows newer than the last
+// point (since_ts) and append them; reloadHistory() fetches the whole
+// downsampled window again and discards replies to older requests.
 void MainWindow::updateHistoryData() {
-    QString url = QString("http://localhost:8080/api/history?seconds=%1").arg(currentPeriodSeconds);
+    bool incremental = historyLoaded && series->count() > 0;
+    QString url = QString("http://localhost:8080/api/history.bin?seconds=%1").arg(currentPeriodSeconds);
+    if (incremental) {
+        url += QString("&since_ts=%1").arg(qint64(series->at(series->count() - 1).x()));
+    } else {
+        url += QString("&max_points=%1&mode=lttb").arg(HISTORY_MAX_POINTS);
+    }
     QNetworkRequest request((QUrl(url)));
     QNetworkReply *reply = networkManager->get(request);
-    connect(reply, &QNetworkReply::finished, this, [this, reply](){ onHistoryDataReceived(reply); });
+    int generation = historyGeneration;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, generation, incremental]() {
+        onHistoryDataReceived(reply, generation, incremental);
+    });
+}
+
+void MainWindow::reloadHistory() {
+    ++historyGeneration;
+    historyLoaded = false;
+    updateHistoryData();
 }
 
 void MainWindow::onCurrentDataReceived(QNetworkReply *reply) {
@@ -107,45 +164,95 @@ void MainWindow::onCurrentDataReceived(QNetworkReply *reply) {
     reply->deleteLater();
 }
 
-void MainWindow::onHistoryDataReceived(QNetworkReply *reply) {
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray data = reply->readAll();
-        QJsonDocument doc = QJsonDocument::fromJson(data);
-        QJsonArray arr = doc.array();
+void MainWindow::onHistoryDataReceived(QNetworkReply *reply, int generation, bool incremental) {
+    if (reply->error() == QNetworkReply::NoError && generation == historyGeneration) {
         QList<QPointF> points;
-        double minTemp = 100, maxTemp = -100, sumTemp = 0;
-        for (const auto &val : arr) {
-            QJsonObject obj = val.toObject();
-            double temp = obj["temp"].toDouble();
-            QString timeStr = obj["time"].toString();
-            QDateTime dt = QDateTime::fromString(timeStr, "yyyy-MM-dd HH:mm:ss");
-            if (!dt.isValid()) dt = QDateTime::fromString(timeStr, Qt::ISODate);
-            if (dt.isValid()) {
-                #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
-                    dt.setTimeSpec(Qt::UTC);
-                #else
-                    dt.setTimeZone(QTimeZone::UTC);
-                #endif
-                QDateTime localDt = dt.toLocalTime();
-                points.append(QPointF(localDt.toMSecsSinceEpoch(), temp));
-                sumTemp += temp;
-                if (temp < minTemp) minTemp = temp;
-                if (temp > maxTemp) maxTemp = temp;
-            }
-        }
-        if (!points.isEmpty()) {
-            double avg = sumTemp / points.size();
-            averageTempLabel->setText(QString("Avg (Period): %1 °C").arg(avg, 0, 'f', 2));
-            std::sort(points.begin(), points.end(), [](const QPointF &a, const QPointF &b) { return a.x() < b.x(); });
+        if (!decodeHistoryBlocks(reply->readAll(), points)) points.clear();
+        if (!incremental) {
             series->replace(points);
-            axisY->setRange(minTemp - 2, maxTemp + 2);
-            QDateTime first = QDateTime::fromMSecsSinceEpoch(points.first().x());
-            QDateTime last = QDateTime::fromMSecsSinceEpoch(points.last().x());
-            axisX->setRange(first, last);
-        } else {
-            averageTempLabel->setText("Avg (Period): -- °C");
-            series->clear();
+            historyLoaded = true;
+        } else if (!points.isEmpty()) {
+            double last = series->count() > 0 ? series->at(series->count() - 1).x() : 0;
+            QList<QPointF> fresh;
+            for (const QPointF &p : points) {
+                if (p.x() > last) fresh.append(p);
+            }
+            series->append(fresh);
+            trimExpired(points.last().x());
         }
+        if (series->count() > 2 * HISTORY_MAX_POINTS) reloadHistory();
+        else refreshChartStats();
     }
     reply->deleteLater();
+}
+
+void MainWindow::trimExpired(double newestMs) {
+    const double cutoff = newestMs - currentPeriodSeconds * 1000.0;
+    int expired = 0;
+    while (expired < series->count() && series->at(expired).x() < cutoff) ++expired;
+    if (expired) series->removePoints(0, expired);
+}
+
+void MainWindow::refreshChartStats() {
+    const QList<QPointF> points = series->points();
+    if (points.isEmpty()) {
+        averageTempLabel->setText("Avg (Period): -- °C");
+        return;
+    }
+    double minTemp = 100, maxTemp = -100, sumTemp = 0;
+    for (const QPointF &p : points) {
+        sumTemp += p.y();
+        if (p.y() < minTemp) minTemp = p.y();
+        if (p.y() > maxTemp) maxTemp = p.y();
+    }
+    double avg = sumTemp / points.size();
+    averageTempLabel->setText(QString("Avg (Period): %1 °C").arg(avg, 0, 'f', 2));
+    axisY->setRange(minTemp - 2, maxTemp + 2);
+    QDateTime first = QDateTime::fromMSecsSinceEpoch(points.first().x());
+    QDateTime last = QDateTime::fromMSecsSinceEpoch(points.last().x());
+    axisX->setRange(first, last);
+}
+
+// Live samples and per-minute aggregates arrive as binary frames over
+// /api/ws. While the socket is down the refresh timer polls the REST
+// endpoints instead and a reconnect is attempted every two seconds.
+// Reconnects follow every return to UnconnectedState: a failed open()
+// reports only an error, never disconnected().
+void MainWindow::onSocketConnected() {
+    refreshTimer->stop();
+    reloadHistory();
+}
+
+void MainWindow::onSocketDisconnected() {
+    if (!refreshTimer->isActive()) refreshTimer->start(1000);
+    QTimer::singleShot(2000, this, [this]() { liveSocket->open(QUrl("ws://localhost:8080/api/ws")); });
+}
+
+void MainWindow::onSocketMessage(const QByteArray &message) {
+    const uchar *p = reinterpret_cast<const uchar *>(message.constData());
+    auto readFloat = [](const uchar *at) {
+        quint32 bits = qFromLittleEndian<quint32>(at);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return double(value);
+    };
+    if (message.size() == 13 && p[0] == 1) {
+        qint64 ms = qFromLittleEndian<qint64>(p + 1);
+        QString time = QDateTime::fromMSecsSinceEpoch(ms).toUTC().toString("yyyy-MM-dd HH:mm:ss");
+        appendLivePoint(ms, readFloat(p + 9), time);
+    } else if (message.size() == 29 && p[0] == 2) {
+        windowStatsLabel->setText(QString("Last minute: min %1 / avg %2 / max %3 °C")
+                                      .arg(readFloat(p + 13), 0, 'f', 2)
+                                      .arg(readFloat(p + 21), 0, 'f', 2)
+                                      .arg(readFloat(p + 17), 0, 'f', 2));
+    }
+}
+
+void MainWindow::appendLivePoint(qint64 ms, double temp, const QString &time) {
+    currentTempLabel->setText(QString("Current: %1 °C").arg(temp, 0, 'f', 2));
+    lastUpdateLabel->setText("Last update: " + time);
+    series->append(double(ms), temp);
+    trimExpired(double(ms));
+    if (series->count() > 2 * HISTORY_MAX_POINTS) reloadHistory();
+    else refreshChartStats();
 }
\ No newline at end of file
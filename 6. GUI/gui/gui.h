@@ -3,6 +3,7 @@
 #include <QtCharts>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QWebSocket>
 #include <QTimer>
 
 class MainWindow : public QMainWindow {
@@ -13,17 +14,27 @@ public:
 private slots:
     void updateCurrentData();
     void updateHistoryData();
+    void reloadHistory();
     void onPeriodChanged(int seconds);
     void onCurrentDataReceived(QNetworkReply *reply);
-    void onHistoryDataReceived(QNetworkReply *reply);
+    void onHistoryDataReceived(QNetworkReply *reply, int generation, bool incremental);
+    void onSocketConnected();
+    void onSocketDisconnected();
+    void onSocketMessage(const QByteArray &message);
 private:
     void setupUi();
-    QLabel *currentTempLabel, *averageTempLabel, *lastUpdateLabel;
+    void appendLivePoint(qint64 ms, double temp, const QString &time);
+    void trimExpired(double newestMs);
+    void refreshChartStats();
+    QLabel *currentTempLabel, *averageTempLabel, *windowStatsLabel, *lastUpdateLabel;
     QChartView *chartView;
     QLineSeries *series;
     QDateTimeAxis *axisX;
     QValueAxis *axisY;
     QNetworkAccessManager *networkManager;
     QTimer *refreshTimer;
+    QWebSocket *liveSocket;
     int currentPeriodSeconds;
+    int historyGeneration = 0;
+    bool historyLoaded = false;
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include "broadcast.h"
+#include "websocket.h"
+
+static size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+Broadcast::Broadcast(size_t capacity)
+    : events(round_up_pow2(capacity ? capacity : 1)), mask(events.size() - 1) {}
+
+void Broadcast::attach(Poller& poller) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pollers.push_back(&poller);
+}
+
+void Broadcast::publish(const char* name, const std::string& json, const std::string& binary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t seq = next.load(std::memory_order_relaxed);
+    Event& event = events[seq & mask];
+    event.sse.assign("id: ");
+    event.sse += std::to_string(seq);
+    if (name) {
+        event.sse += "\nevent: ";
+        event.sse += name;
+    }
+    event.sse += "\ndata: ";
+    event.sse += json;
+    event.sse += "\n\n";
+    event.ws.clear();
+    websocket_frame(event.ws, WsOpcode::Binary, binary.data(), binary.size());
+    next.store(seq + 1, std::memory_order_release);
+    for (Poller* p : pollers) p->wake();
+}
+
+bool Broadcast::read_since(uint64_t& cursor, Format format, std::string& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t end = next.load(std::memory_order_relaxed);
+    uint64_t oldest = end > events.size() ? end - events.size() : 1;
+    if (cursor < oldest) return false;
+    for (; cursor < end; ++cursor) {
+        const Event& event = events[cursor & mask];
+        out += format == Format::Sse ? event.sse : event.ws;
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "poller.h"
+
+// Live event fan-out. Every event is framed once per wire format (an SSE
+// text event and a binary WebSocket frame) into a bounded ring; subscribers
+// keep a sequence cursor and copy only what they have not seen yet.
+// A subscriber more than one ring behind has lost events; read_since reports
+// that instead of skipping ahead. Attached pollers are woken on publish.
+class Broadcast {
+public:
+    enum class Format { Sse, WebSocket };
+    explicit Broadcast(size_t capacity = 1024);
+    void attach(Poller& poller);
+    void publish(const char* name, const std::string& json, const std::string& binary);
+    uint64_t head() const { return next.load(std::memory_order_acquire); }
+    // Appends events from cursor up to head and advances cursor; false (and
+    // nothing appended) if some of those events were already overwritten.
+    bool read_since(uint64_t& cursor, Format format, std::string& out) const;
+private:
+    struct Event {
+        std::string sse;
+        std::string ws;
+    };
+    std::vector<Event> events;
+    size_t mask;
+    std::atomic<uint64_t> next{1};
+    std::vector<Poller*> pollers;
+    mutable std::mutex mutex;
+};
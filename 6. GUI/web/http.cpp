@@ -0,0 +1,167 @@
+#include "http.h"
+#include <charconv>
+
+static bool iequals(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char x = a[i], y = b[i];
+        if (x >= 'A' && x <= 'Z') x = char(x - 'A' + 'a');
+        if (y >= 'A' && y <= 'Z') y = char(y - 'A' + 'a');
+        if (x != y) return false;
+    }
+    return true;
+}
+
+static std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string_view HttpRequest::header(std::string_view name) const {
+    for (const auto& h : headers) {
+        if (iequals(h.first, name)) return h.second;
+    }
+    return {};
+}
+
+bool HttpRequest::header_has_token(std::string_view name, std::string_view token) const {
+    std::string_view value = header(name);
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        if (iequals(trim(item.substr(0, item.find(';'))), token)) return true;
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+    }
+    return false;
+}
+
+bool HttpRequest::keep_alive() const {
+    std::string_view connection = header("Connection");
+    if (iequals(connection, "close")) return false;
+    if (version == "HTTP/1.0") return iequals(connection, "keep-alive");
+    return true;
+}
+
+HttpParser::Result HttpParser::parse(std::string_view buffer, HttpRequest& request, size_t& consumed) {
+    size_t from = scanned > 3 ? scanned - 3 : 0;
+    size_t end = buffer.find("\r\n\r\n", from);
+    if (end == std::string_view::npos) {
+        scanned = buffer.size();
+        if (buffer.size() > MAX_HEADER_BYTES) {
+            status = 431;
+            return Result::Error;
+        }
+        return Result::Incomplete;
+    }
+    if (end + 4 > MAX_HEADER_BYTES) {
+        status = 431;
+        return Result::Error;
+    }
+    status = 400;
+    std::string_view head = buffer.substr(0, end + 2);
+
+    size_t line_end = head.find("\r\n");
+    std::string_view line = head.substr(0, line_end);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = sp1 == std::string_view::npos ? sp1 : line.find(' ', sp1 + 1);
+    if (sp1 == 0 || sp2 == std::string_view::npos || sp2 == sp1 + 1) return Result::Error;
+    request = HttpRequest();
+    request.method = line.substr(0, sp1);
+    request.target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    request.version = line.substr(sp2 + 1);
+    if (request.version != "HTTP/1.1" && request.version != "HTTP/1.0") {
+        status = 505;
+        return Result::Error;
+    }
+    size_t qmark = request.target.find('?');
+    request.path = request.target.substr(0, qmark);
+    if (qmark != std::string_view::npos) request.query = request.target.substr(qmark + 1);
+
+    size_t pos = line_end + 2;
+    while (pos < head.size()) {
+        size_t eol = head.find("\r\n", pos);
+        std::string_view field = head.substr(pos, eol - pos);
+        pos = eol + 2;
+        size_t colon = field.find(':');
+        if (colon == std::string_view::npos || colon == 0) return Result::Error;
+        if (request.headers.size() == MAX_HEADERS) {
+            status = 431;
+            return Result::Error;
+        }
+        request.headers.emplace_back(field.substr(0, colon), trim(field.substr(colon + 1)));
+    }
+
+    if (!request.header("Transfer-Encoding").empty()) {
+        status = 501;
+        return Result::Error;
+    }
+    size_t body = 0;
+    std::string_view length = request.header("Content-Length");
+    if (!length.empty()) {
+        auto res = std::from_chars(length.data(), length.data() + length.size(), body);
+        if (res.ec != std::errc() || res.ptr != length.data() + length.size()) return Result::Error;
+        if (body > MAX_BODY_BYTES) {
+            status = 413;
+            return Result::Error;
+        }
+    }
+    if (buffer.size() < end + 4 + body) {
+        scanned = end;
+        return Result::Incomplete;
+    }
+    consumed = end + 4 + body;
+    scanned = 0;
+    return Result::Complete;
+}
+
+bool query_param(std::string_view query, std::string_view key, std::string& value) {
+    while (!query.empty()) {
+        size_t amp = query.find('&');
+        std::string_view pair = query.substr(0, amp);
+        query = amp == std::string_view::npos ? std::string_view() : query.substr(amp + 1);
+        size_t eq = pair.find('=');
+        if (pair.substr(0, eq) != key) continue;
+        std::string_view raw = eq == std::string_view::npos ? std::string_view() : pair.substr(eq + 1);
+        value.clear();
+        for (size_t i = 0; i < raw.size(); ++i) {
+            if (raw[i] == '+') {
+                value += ' ';
+            } else if (raw[i] == '%' && i + 2 < raw.size() && hex_value(raw[i + 1]) >= 0 && hex_value(raw[i + 2]) >= 0) {
+                value += char(hex_value(raw[i + 1]) * 16 + hex_value(raw[i + 2]));
+                i += 2;
+            } else {
+                value += raw[i];
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+int query_int(std::string_view query, std::string_view key, int fallback, int min_value, int max_value) {
+    std::string text;
+    if (!query_param(query, key, text)) return fallback;
+    int value = 0;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (res.ec != std::errc() || res.ptr != text.data() + text.size()) return fallback;
+    if (value < min_value) return min_value;
+    if (value > max_value) return max_value;
+    return value;
+}
+
+int64_t query_int64(std::string_view query, std::string_view key, int64_t fallback) {
+    std::string text;
+    if (!query_param(query, key, text)) return fallback;
+    int64_t value = 0;
+    auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (res.ec != std::errc() || res.ptr != text.data() + text.size()) return fallback;
+    return value;
+}
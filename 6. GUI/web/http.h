@@ -0,0 +1,38 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+struct HttpRequest {
+    std::string_view method;
+    std::string_view target;
+    std::string_view path;
+    std::string_view query;
+    std::string_view version;
+    std::vector<std::pair<std::string_view, std::string_view>> headers;
+    std::string_view header(std::string_view name) const;
+    bool header_has_token(std::string_view name, std::string_view token) const;
+    bool keep_alive() const;
+};
+
+// Incremental request parser. Views in HttpRequest point into the buffer
+// passed to parse() and stay valid until the caller consumes those bytes.
+class HttpParser {
+public:
+    enum class Result { Incomplete, Complete, Error };
+    static const size_t MAX_HEADER_BYTES = 16 * 1024;
+    static const size_t MAX_HEADERS = 64;
+    static const size_t MAX_BODY_BYTES = 64 * 1024;
+    Result parse(std::string_view buffer, HttpRequest& request, size_t& consumed);
+    int error_status() const { return status; }
+private:
+    size_t scanned = 0;
+    int status = 400;
+};
+
+bool query_param(std::string_view query, std::string_view key, std::string& value);
+int query_int(std::string_view query, std::string_view key, int fallback, int min_value, int max_value);
+int64_t query_int64(std::string_view query, std::string_view key, int64_t fallback);
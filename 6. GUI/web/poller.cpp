@@ -0,0 +1,220 @@
+#include "poller.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+bool set_nonblocking(int fd) {
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+#endif
+}
+
+bool would_block() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+void close_socket(int fd) {
+#ifdef _WIN32
+    closesocket(fd);
+#else
+    close(fd);
+#endif
+}
+
+long sock_read(int fd, char* data, size_t size) {
+#ifdef _WIN32
+    return recv(fd, data, (int)size, 0);
+#else
+    return (long)read(fd, data, size);
+#endif
+}
+
+long sock_write(int fd, const char* data, size_t size) {
+#ifdef _WIN32
+    return send(fd, data, (int)size, 0);
+#elif defined(MSG_NOSIGNAL)
+    return (long)send(fd, data, size, MSG_NOSIGNAL);
+#else
+    return (long)write(fd, data, size);
+#endif
+}
+
+// Gathers a response head and a shared body into one send call.
+long sock_write2(int fd, const char* head, size_t head_size, const char* body, size_t body_size) {
+    if (body_size == 0) return sock_write(fd, head, head_size);
+#ifdef _WIN32
+    WSABUF bufs[2] = {{(ULONG)head_size, (CHAR*)head}, {(ULONG)body_size, (CHAR*)body}};
+    DWORD sent = 0;
+    if (WSASend(fd, bufs + (head_size ? 0 : 1), head_size ? 2 : 1, &sent, 0, nullptr, nullptr) != 0) return -1;
+    return (long)sent;
+#else
+    iovec iov[2] = {{(void*)head, head_size}, {(void*)body, body_size}};
+    msghdr msg{};
+    msg.msg_iov = iov + (head_size ? 0 : 1);
+    msg.msg_iovlen = head_size ? 2 : 1;
+#ifdef MSG_NOSIGNAL
+    return (long)sendmsg(fd, &msg, MSG_NOSIGNAL);
+#else
+    return (long)sendmsg(fd, &msg, 0);
+#endif
+#endif
+}
+
+void Poller::wake() {
+#ifdef __linux__
+    uint64_t one = 1;
+    if (write(wake_fds[0], &one, sizeof(one)) < 0) return;
+#elif !defined(_WIN32)
+    char one = 1;
+    if (write(wake_fds[1], &one, 1) < 0) return;
+#endif
+}
+
+bool Poller::can_wake() const {
+    return wake_fds[0] != -1;
+}
+
+void Poller::drain_wake() {
+#ifndef _WIN32
+    char buf[64];
+    while (read(wake_fds[0], buf, sizeof(buf)) > 0) {}
+#endif
+}
+
+#ifdef __linux__
+
+Poller::Poller() : epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {
+    wake_fds[0] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = wake_fds[0];
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fds[0], &ev);
+}
+
+Poller::~Poller() {
+    close(wake_fds[0]);
+    close(epoll_fd);
+}
+
+bool Poller::add(int fd) {
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+void Poller::remove(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void Poller::want_write(int, bool) {}
+
+int Poller::wait(std::vector<PollEvent>& events, int timeout_ms) {
+    epoll_event ready[256];
+    events.clear();
+    int n = epoll_wait(epoll_fd, ready, 256, timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        if (ready[i].data.fd == wake_fds[0]) {
+            drain_wake();
+            continue;
+        }
+        uint32_t e = ready[i].events;
+        events.push_back(PollEvent{ready[i].data.fd, (e & EPOLLIN) != 0, (e & EPOLLOUT) != 0,
+                                   (e & (EPOLLERR | EPOLLHUP)) != 0});
+    }
+    return (int)events.size();
+}
+
+#else
+
+#ifdef _WIN32
+typedef WSAPOLLFD pollfd_t;
+#define poll_fn WSAPoll
+#else
+typedef pollfd pollfd_t;
+#define poll_fn poll
+#endif
+
+Poller::Poller() {
+#ifndef _WIN32
+    if (pipe(wake_fds) == 0) {
+        set_nonblocking(wake_fds[0]);
+        set_nonblocking(wake_fds[1]);
+        entries.push_back(Entry{wake_fds[0], false});
+    }
+#endif
+}
+
+Poller::~Poller() {
+#ifndef _WIN32
+    if (wake_fds[0] != -1) {
+        close(wake_fds[0]);
+        close(wake_fds[1]);
+    }
+#endif
+}
+
+bool Poller::add(int fd) {
+    entries.push_back(Entry{fd, false});
+    return true;
+}
+
+void Poller::remove(int fd) {
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].fd == fd) {
+            entries[i] = entries.back();
+            entries.pop_back();
+            return;
+        }
+    }
+}
+
+void Poller::want_write(int fd, bool enabled) {
+    for (Entry& e : entries) {
+        if (e.fd == fd) e.write = enabled;
+    }
+}
+
+int Poller::wait(std::vector<PollEvent>& events, int timeout_ms) {
+    events.clear();
+    std::vector<pollfd_t> fds(entries.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        fds[i].fd = entries[i].fd;
+        fds[i].events = entries[i].write ? (POLLIN | POLLOUT) : POLLIN;
+        fds[i].revents = 0;
+    }
+    int n = poll_fn(fds.data(), (unsigned long)fds.size(), timeout_ms);
+    if (n <= 0) return 0;
+    for (const pollfd_t& p : fds) {
+        if (!p.revents) continue;
+        if ((int)p.fd == wake_fds[0]) {
+            drain_wake();
+            continue;
+        }
+        events.push_back(PollEvent{(int)p.fd, (p.revents & POLLIN) != 0, (p.revents & POLLOUT) != 0,
+                                   (p.revents & (POLLERR | POLLHUP | POLLNVAL)) != 0});
+    }
+    return (int)events.size();
+}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#ifndef _WIN32
+#include <sys/types.h>
+#endif
+
+bool set_nonblocking(int fd);
+bool would_block();
+void close_socket(int fd);
+long sock_read(int fd, char* data, size_t size);
+long sock_write(int fd, const char* data, size_t size);
+long sock_write2(int fd, const char* head, size_t head_size, const char* body, size_t body_size);
+
+struct PollEvent {
+    int fd;
+    bool readable;
+    bool writable;
+    bool closed;
+};
+
+// Readiness notification for non-blocking sockets. Linux uses an
+// edge-triggered epoll set; elsewhere poll()/WSAPoll is used. Callers must
+// always drain reads and writes until they would block, which is correct
+// for both. wake() interrupts a blocked wait() from another thread; on
+// Windows it is a no-op and callers should use a short timeout instead.
+class Poller {
+public:
+    Poller();
+    ~Poller();
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+    bool add(int fd);
+    void remove(int fd);
+    void want_write(int fd, bool enabled);
+    int wait(std::vector<PollEvent>& events, int timeout_ms);
+    void wake();
+    bool can_wake() const;
+private:
+    int wake_fds[2] = {-1, -1};
+    void drain_wake();
+#ifdef __linux__
+    int epoll_fd;
+#else
+    struct Entry {
+        int fd;
+        bool write;
+    };
+    std::vector<Entry> entries;
+#endif
+};
@@ -0,0 +1,55 @@
+#include "response_cache.h"
+
+ResponseCache::ResponseCache(size_t capacity) : capacity(capacity ? capacity : 1) {}
+
+std::shared_ptr<const std::string> ResponseCache::get(const std::string& key, uint64_t generation,
+                                                      const std::function<std::string()>& compute) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = slots.find(key);
+    while (it != slots.end() && it->second.generation == generation && !it->second.body && it->second.computing) {
+        ready.wait(lock);
+        it = slots.find(key);
+    }
+    if (it != slots.end() && it->second.generation == generation && it->second.body) return it->second.body;
+    bool owner = it == slots.end() || it->second.generation < generation ||
+                 (it->second.generation == generation && !it->second.computing);
+    if (owner) {
+        if (it == slots.end() && slots.size() >= capacity) evict(generation);
+        Slot& slot = slots[key];
+        slot.generation = generation;
+        slot.computing = true;
+        slot.body.reset();
+    }
+    lock.unlock();
+
+    std::shared_ptr<const std::string> body;
+    try {
+        body = std::make_shared<const std::string>(compute());
+    } catch (...) {
+        lock.lock();
+        it = slots.find(key);
+        if (owner && it != slots.end() && it->second.generation == generation) slots.erase(it);
+        ready.notify_all();
+        throw;
+    }
+    if (!owner) return body;
+    lock.lock();
+    it = slots.find(key);
+    if (it != slots.end() && it->second.generation == generation) {
+        it->second.body = body;
+        it->second.computing = false;
+    }
+    ready.notify_all();
+    return body;
+}
+
+void ResponseCache::evict(uint64_t generation) {
+    for (auto it = slots.begin(); it != slots.end();) {
+        if (!it->second.computing && it->second.generation < generation) it = slots.erase(it);
+        else ++it;
+    }
+    for (auto it = slots.begin(); slots.size() >= capacity && it != slots.end();) {
+        if (!it->second.computing) it = slots.erase(it);
+        else ++it;
+    }
+}
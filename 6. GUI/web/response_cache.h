@@ -0,0 +1,31 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Rendered API responses keyed by normalized route and parameters. An
+// entry is only reused for the data generation it was computed at;
+// concurrent misses on one key wait for the first computation instead of
+// repeating it.
+class ResponseCache {
+public:
+    explicit ResponseCache(size_t capacity = 64);
+    std::shared_ptr<const std::string> get(const std::string& key, uint64_t generation,
+                                           const std::function<std::string()>& compute);
+private:
+    struct Slot {
+        uint64_t generation = 0;
+        bool computing = false;
+        std::shared_ptr<const std::string> body;
+    };
+    void evict(uint64_t generation);
+    size_t capacity;
+    std::unordered_map<std::string, Slot> slots;
+    std::mutex mutex;
+    std::condition_variable ready;
+};
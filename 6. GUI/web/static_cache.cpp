@@ -0,0 +1,118 @@
+#include "static_cache.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+static std::string content_etag(const std::string& data) {
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char ch : data) hash = (hash ^ ch) * 1099511628211ull;
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%016llx\"", (unsigned long long)hash);
+    return etag;
+}
+
+#ifdef HAVE_ZLIB
+static bool gzip_compress(const std::string& data, std::string& out) {
+    z_stream zs{};
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+    out.resize(deflateBound(&zs, (uLong)data.size()));
+    zs.next_in = (Bytef*)data.data();
+    zs.avail_in = (uInt)data.size();
+    zs.next_out = (Bytef*)&out[0];
+    zs.avail_out = (uInt)out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+#endif
+
+StaticCache::StaticCache(const std::string& path, const std::string& content_type)
+    : path(path), content_type(content_type) {
+    load();
+}
+
+StaticCache::~StaticCache() {
+    stopping = true;
+    if (watcher.joinable()) watcher.join();
+}
+
+std::shared_ptr<const StaticAsset> StaticCache::get() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (asset) return asset;
+    }
+    load();
+    std::lock_guard<std::mutex> lock(mutex);
+    return asset;
+}
+
+void StaticCache::load() {
+    std::ifstream f(path, std::ios::binary);
+    if (!f.good()) return;
+    auto next = std::make_shared<StaticAsset>();
+    std::string body((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    next->etag = content_etag(body);
+    std::string common = "Access-Control-Allow-Origin: *\r\nCache-Control: no-cache\r\nETag: " + next->etag +
+                         "\r\nVary: Accept-Encoding\r\n";
+    next->not_modified = "HTTP/1.1 304 Not Modified\r\n" + common;
+    common = "HTTP/1.1 200 OK\r\nContent-Type: " + content_type + "\r\n" + common;
+#ifdef HAVE_ZLIB
+    std::string packed;
+    if (gzip_compress(body, packed) && packed.size() < body.size()) {
+        next->gzip.head = common + "Content-Encoding: gzip\r\nContent-Length: " + std::to_string(packed.size()) +
+                          "\r\n";
+        next->gzip.body = std::move(packed);
+    }
+#endif
+    next->identity.head = common + "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    next->identity.body = std::move(body);
+    std::lock_guard<std::mutex> lock(mutex);
+    asset = std::move(next);
+}
+
+void StaticCache::watch() {
+#ifdef __linux__
+    if (!watcher.joinable()) watcher = std::thread(&StaticCache::watch_loop, this);
+#endif
+}
+
+void StaticCache::watch_loop() {
+#ifdef __linux__
+    size_t slash = path.rfind('/');
+    std::string dir = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return;
+    if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+        close(fd);
+        return;
+    }
+    alignas(inotify_event) char buffer[4096];
+    while (!stopping) {
+        pollfd p{fd, POLLIN, 0};
+        if (poll(&p, 1, 1000) <= 0) continue;
+        bool changed = false;
+        long n;
+        while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + n;) {
+                inotify_event* ev = reinterpret_cast<inotify_event*>(at);
+                if (ev->len && name == ev->name) changed = true;
+                at += sizeof(inotify_event) + ev->len;
+            }
+        }
+        if (changed) load();
+    }
+    close(fd);
+#endif
+}
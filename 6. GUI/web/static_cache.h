@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// One file held in memory with its response heads prepared up front:
+// identity and (with zlib) gzip bodies, a content ETag and a 304 head.
+// Heads end before the Connection header, which depends on the request.
+struct StaticAsset {
+    struct Variant {
+        std::string head;
+        std::string body;
+    };
+    std::string etag;
+    std::string not_modified;
+    Variant identity;
+    Variant gzip;
+};
+
+// Loads the file once and swaps in a new snapshot when it changes on disk
+// (inotify on Linux; elsewhere only a missing file is retried).
+class StaticCache {
+public:
+    StaticCache(const std::string& path, const std::string& content_type);
+    ~StaticCache();
+    StaticCache(const StaticCache&) = delete;
+    StaticCache& operator=(const StaticCache&) = delete;
+    std::shared_ptr<const StaticAsset> get();
+    void watch();
+private:
+    void load();
+    void watch_loop();
+    std::string path;
+    std::string content_type;
+    std::shared_ptr<const StaticAsset> asset;
+    std::mutex mutex;
+    std::atomic<bool> stopping{false};
+    std::thread watcher;
+};
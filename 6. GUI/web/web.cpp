@@ -1,67 +1,631 @@
 #include "web.h"
+#include "websocket.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
 #ifdef _WIN32
 #include <winsock2.h>
 #pragma comment(lib, "ws2_32.lib")
 #else
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #endif
 
-void WebServer::start(Database& db) {
-#ifdef _WIN32
-    WSADATA wsaData;
-    WSAStartup(MAKEWORD(2, 2), &wsaData);
-#endif
+static const size_t STREAM_FLUSH_SIZE = 64 * 1024;
+static const int STREAM_PAGE_ROWS = 2000;
+static const std::chrono::seconds IDLE_TIMEOUT(15);
+static const size_t MAX_PUSH_BACKLOG = 1024 * 1024;
+static const int LIVE_WINDOW_SECONDS = 60;
+static const int CURSOR_ROW_LIMIT = 10000;
+
+static const char* status_text(int status) {
+    switch (status) {
+    case 405: return "405 Method Not Allowed";
+    case 413: return "413 Payload Too Large";
+    case 431: return "431 Request Header Fields Too Large";
+    case 501: return "501 Not Implemented";
+    case 505: return "505 HTTP Version Not Supported";
+    default: return "400 Bad Request";
+    }
+}
+
+static void put_le(std::string& out, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(char((value >> (8 * i)) & 0xff));
+}
+
+static void put_float(std::string& out, double value) {
+    float f = float(value);
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    put_le(out, bits, 4);
+}
+
+struct HistoryQuery {
+    int seconds;
+    int max_points;
+    DownsampleMode mode = DownsampleMode::Rollup;
+    int64_t since_id;
+    int64_t since_ts;
+    bool cursor() const { return since_id >= 0 || since_ts >= 0; }
+    int cursor_limit() const { return max_points > 0 ? max_points : CURSOR_ROW_LIMIT; }
+    bool bounded() const { return cursor() || max_points > 0; }
+    // The window edge (now - seconds) moves even when no rows arrive, so the key
+    // also carries a time slot: one second, or one output bucket if that is coarser.
+    std::string key(const char* route) const {
+        int64_t slot_ms = 1000;
+        if (!cursor() && max_points > 0 && int64_t(seconds) * 1000 / max_points > slot_ms)
+            slot_ms = int64_t(seconds) * 1000 / max_points;
+        char buf[160];
+        snprintf(buf, sizeof(buf), "%s?s=%d&n=%d&m=%d&id=%lld&ts=%lld&t=%lld", route, seconds, max_points, int(mode),
+                 (long long)since_id, (long long)since_ts, (long long)(Database::now_ms() / slot_ms));
+        return buf;
+    }
+};
+
+static HistoryQuery parse_history_query(const HttpRequest& request) {
+    HistoryQuery q;
+    q.seconds = query_int(request.query, "seconds", 3600, 1, 10 * 366 * 86400);
+    q.max_points = query_int(request.query, "max_points", 0, 0, 100000);
+    std::string mode;
+    if (query_param(request.query, "mode", mode)) parse_downsample_mode(mode, q.mode);
+    q.since_id = query_int64(request.query, "since_id", -1);
+    q.since_ts = query_int64(request.query, "since_ts", -1);
+    return q;
+}
+
+int WebServer::open_listener(bool reuse_port) {
     int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    sockaddr_in address;
+    int on = 1;
+    setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&on, sizeof(on));
+#ifdef SO_REUSEPORT
+    if (reuse_port) setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, (const char*)&on, sizeof(on));
+#else
+    (void)reuse_port;
+#endif
+    sockaddr_in address{};
     address.sin_family = AF_INET;
     address.sin_addr.s_addr = INADDR_ANY;
     address.sin_port = htons(port);
-    bind(server_fd, (struct sockaddr*)&address, sizeof(address));
-    listen(server_fd, 3);
-    
-    while (true) {
-        int new_socket = accept(server_fd, nullptr, nullptr);
-        if (new_socket < 0) continue;
-        char buffer[2048] = {0};
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(server_fd, SOMAXCONN) < 0) {
+        std::cerr << "Failed to listen on port " << port << std::endl;
+        close_socket(server_fd);
+        return -1;
+    }
+    set_nonblocking(server_fd);
+    return server_fd;
+}
+
+// Live messages go out as SSE events with JSON data and as binary
+// WebSocket frames, little-endian:
+//   sample:    uint8 1, int64 time_ms, float32 temp
+//   aggregate: uint8 2, int32 seconds, int64 bucket_ms, float32 min, max, avg, uint32 count
+// An aggregate for the previous window is sent when a sample opens the next one.
+void WebServer::publish_sample(const Sample& s) {
+    int64_t bucket = s.time_ms - s.time_ms % (LIVE_WINDOW_SECONDS * 1000);
+    if (bucket != window.bucket_ms) {
+        if (window.count) publish_aggregate();
+        window = LiveWindow();
+        window.bucket_ms = bucket;
+        window.min = window.max = s.temp;
+    }
+    if (s.temp < window.min) window.min = s.temp;
+    if (s.temp > window.max) window.max = s.temp;
+    window.sum += s.temp;
+    ++window.count;
+
+    JsonWriter json;
+    json.raw("{\"ts\":");
+    json.integer(s.time_ms);
+    json.raw(",\"time\":");
+    json.time(s.time_ms);
+    json.raw(",\"temp\":");
+    json.number(s.temp);
+    json.raw("}");
+    std::string binary;
+    put_le(binary, 1, 1);
+    put_le(binary, uint64_t(s.time_ms), 8);
+    put_float(binary, s.temp);
+    live.publish(nullptr, json.str(), binary);
+}
+
+void WebServer::publish_aggregate() {
+    double avg = window.sum / window.count;
+    JsonWriter json;
+    json.raw("{\"seconds\":");
+    json.integer(LIVE_WINDOW_SECONDS);
+    json.raw(",\"bucket\":");
+    json.integer(window.bucket_ms);
+    json.raw(",\"time\":");
+    json.time(window.bucket_ms);
+    json.raw(",\"min\":");
+    json.number(window.min);
+    json.raw(",\"max\":");
+    json.number(window.max);
+    json.raw(",\"avg\":");
+    json.number(avg);
+    json.raw(",\"count\":");
+    json.integer(window.count);
+    json.raw("}");
+    std::string binary;
+    put_le(binary, 2, 1);
+    put_le(binary, uint32_t(LIVE_WINDOW_SECONDS), 4);
+    put_le(binary, uint64_t(window.bucket_ms), 8);
+    put_float(binary, window.min);
+    put_float(binary, window.max);
+    put_float(binary, avg);
+    put_le(binary, window.count, 4);
+    live.publish("aggregate", json.str(), binary);
+}
+
+void WebServer::start(Database& db) {
 #ifdef _WIN32
-        recv(new_socket, buffer, 2048, 0);
+    WSADATA wsaData;
+    WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+#ifdef SO_REUSEPORT
+    const bool per_reactor_listener = threads > 1;
 #else
-        read(new_socket, buffer, 2048);
+    const bool per_reactor_listener = false;
 #endif
-        std::string request(buffer);
-        std::string response;
-        std::string header = "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\n";
-        
-        if (request.find("GET /api/current") != std::string::npos) {
-            response = header + "Content-Type: application/json\r\n\r\n" + db.get_current_json();
-        } else if (request.find("GET /api/history") != std::string::npos) {
-            int seconds = 3600;
-            size_t pos = request.find("seconds=");
-            if (pos != std::string::npos) seconds = std::stoi(request.substr(pos + 8));
-            response = header + "Content-Type: application/json\r\n\r\n" + db.get_history_json(seconds);
+    db.on_insert([this](const Sample& s) { publish_sample(s); });
+    assets.watch();
+    int shared_fd = per_reactor_listener ? -1 : open_listener(false);
+    if (!per_reactor_listener && shared_fd < 0) return;
+
+    std::vector<std::unique_ptr<Reactor>> reactors;
+    for (int i = 0; i < threads; ++i) {
+        int fd = per_reactor_listener ? open_listener(true) : shared_fd;
+        if (fd < 0) return;
+        reactors.emplace_back(new Reactor(db, live, assets, cache, stats, fd));
+    }
+    std::vector<std::thread> workers;
+    for (int i = 1; i < threads; ++i) workers.emplace_back(&Reactor::run, reactors[i].get());
+    reactors[0]->run();
+    for (std::thread& t : workers) t.join();
+}
+
+WebServer::Reactor::Reactor(Database& db, Broadcast& live, StaticCache& assets, ResponseCache& cache,
+                            const StatsSources& stats, int listen_fd)
+    : db(db), live(live), assets(assets), cache(cache), stats(stats), live_seen(live.head()), listen_fd(listen_fd) {
+    poller.add(listen_fd);
+    live.attach(poller);
+}
+
+void WebServer::Reactor::run() {
+    std::vector<PollEvent> events;
+    auto last_sweep = std::chrono::steady_clock::now();
+    while (true) {
+        poller.wait(events, push_clients && !poller.can_wake() ? 100 : 1000);
+        if (push_clients && live.head() != live_seen) push_live();
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_sweep >= std::chrono::seconds(1)) {
+            close_idle();
+            last_sweep = now;
+        }
+        for (const PollEvent& ev : events) {
+            if (ev.fd == listen_fd) {
+                accept_clients();
+                continue;
+            }
+            auto it = connections.find(ev.fd);
+            if (it == connections.end()) continue;
+            Connection& c = it->second;
+            if (ev.readable || ev.closed) on_readable(c);
+            if (!c.broken && ev.writable) on_writable(c);
+            if (c.broken || (c.close_after_write && c.out_pos == c.out.size() && !c.body && !c.stream))
+                close_connection(ev.fd);
+        }
+    }
+}
+
+void WebServer::Reactor::accept_clients() {
+    while (true) {
+        int fd = (int)accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) return;
+        set_nonblocking(fd);
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+        Connection& c = connections[fd];
+        c.fd = fd;
+        c.last_active = std::chrono::steady_clock::now();
+        poller.add(fd);
+    }
+}
+
+void WebServer::Reactor::close_connection(int fd) {
+    auto it = connections.find(fd);
+    if (it != connections.end() && it->second.push != Push::None) --push_clients;
+    poller.remove(fd);
+    close_socket(fd);
+    connections.erase(fd);
+}
+
+void WebServer::Reactor::close_idle() {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<int> expired;
+    for (auto& entry : connections) {
+        Connection& c = entry.second;
+        if (c.push != Push::None && now - c.last_active > IDLE_TIMEOUT) {
+            if (c.push == Push::Sse) c.out += ": ping\n\n";
+            else websocket_frame(c.out, WsOpcode::Ping, nullptr, 0);
+            c.last_active = now;
+            flush(c);
+            if (c.broken) expired.push_back(entry.first);
+        } else if (c.push == Push::None && c.out.empty() && !c.body && !c.stream &&
+                   now - c.last_active > IDLE_TIMEOUT) {
+            expired.push_back(entry.first);
+        }
+    }
+    for (int fd : expired) close_connection(fd);
+}
+
+// Reading stops while replies are backed up or a history stream is still being
+// produced, so a client that pipelines without reading cannot grow c.in;
+// on_writable resumes once output drains. With edge-triggered epoll the bytes
+// left in the kernel produce no new event.
+bool WebServer::Reactor::backlogged(const Connection& c) {
+    return c.body || c.out.size() - c.out_pos >= STREAM_FLUSH_SIZE;
+}
+
+void WebServer::Reactor::on_readable(Connection& c) {
+    char buffer[4096];
+    while (true) {
+        if (c.push != Push::Sse && !c.close_after_write && (backlogged(c) || c.stream)) {
+            c.read_paused = true;
+            return;
+        }
+        long n = sock_read(c.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            c.last_active = std::chrono::steady_clock::now();
+            if (c.close_after_write || c.push == Push::Sse) continue;
+            c.in.append(buffer, (size_t)n);
+            process_requests(c);
+        } else if (n == 0 && c.close_after_write) {
+            return;
+        } else if (n == 0 || !would_block()) {
+            c.broken = true;
+            return;
         } else {
-            std::ifstream f("index.html");
-            if (f.good()) {
-                std::stringstream ss;
-                ss << f.rdbuf();
-                response = header + "Content-Type: text/html\r\n\r\n" + ss.str();
-            } else {
-                response = "HTTP/1.1 404 Not Found\r\n\r\nFile not found";
+            return;
+        }
+    }
+}
+
+void WebServer::Reactor::on_writable(Connection& c) {
+    flush(c);
+    if (!c.broken && c.stream && !backlogged(c)) continue_stream(c);
+    if (!c.broken && !c.in.empty()) process_requests(c);
+    if (!c.broken && c.read_paused && !backlogged(c) && !c.stream) {
+        c.read_paused = false;
+        on_readable(c);
+    }
+}
+
+void WebServer::Reactor::process_requests(Connection& c) {
+    if (c.push == Push::WebSocket) {
+        process_frames(c);
+        return;
+    }
+    size_t start = 0;
+    while (!c.close_after_write && c.push == Push::None && !c.broken) {
+        if (c.body) flush(c);
+        if (c.broken || c.stream || backlogged(c)) break;
+        HttpRequest request;
+        size_t consumed = 0;
+        std::string_view pending(c.in.data() + start, c.in.size() - start);
+        HttpParser::Result result = c.parser.parse(pending, request, consumed);
+        if (result == HttpParser::Result::Incomplete) break;
+        if (result == HttpParser::Result::Error) {
+            c.keep_alive = false;
+            respond(c, status_text(c.parser.error_status()), "text/plain", "");
+            c.close_after_write = true;
+            break;
+        }
+        c.keep_alive = request.keep_alive();
+        handle_request(c, request);
+        start += consumed;
+        if (!c.keep_alive && c.push == Push::None) c.close_after_write = true;
+    }
+    c.in.erase(0, start);
+    if (c.close_after_write || c.push == Push::Sse) c.in.clear();
+    if (c.push == Push::WebSocket && !c.in.empty()) process_frames(c);
+    else flush(c);
+}
+
+void WebServer::Reactor::process_frames(Connection& c) {
+    size_t start = 0;
+    while (!c.close_after_write) {
+        WebSocketFrame frame;
+        size_t consumed = 0;
+        std::string_view pending(c.in.data() + start, c.in.size() - start);
+        WebSocketParser::Result result = WebSocketParser::parse(pending, frame, consumed);
+        if (result == WebSocketParser::Result::Incomplete) break;
+        if (result == WebSocketParser::Result::Error) {
+            websocket_frame(c.out, WsOpcode::Close, "\x03\xea", 2);
+            c.close_after_write = true;
+            break;
+        }
+        start += consumed;
+        if (frame.opcode == WsOpcode::Close) {
+            websocket_frame(c.out, WsOpcode::Close, frame.payload.data(), frame.payload.size() < 2 ? 0 : 2);
+            c.close_after_write = true;
+        } else if (frame.opcode == WsOpcode::Ping) {
+            websocket_frame(c.out, WsOpcode::Pong, frame.payload.data(), frame.payload.size());
+        }
+    }
+    c.in.erase(0, start);
+    if (c.close_after_write) c.in.clear();
+    flush(c);
+}
+
+void WebServer::Reactor::respond(Connection& c, const char* status, const char* content_type,
+                                 const std::string& body) {
+    c.out += "HTTP/1.1 ";
+    c.out += status;
+    c.out += "\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: ";
+    c.out += content_type;
+    c.out += "\r\nContent-Length: " + std::to_string(body.size());
+    c.out += c.keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    c.out += body;
+}
+
+void WebServer::Reactor::begin_stream(Connection& c, const char* content_type) {
+    c.chunked = c.keep_alive;
+    c.out += "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: ";
+    c.out += content_type;
+    c.out += c.chunked ? "\r\nTransfer-Encoding: chunked\r\nConnection: keep-alive\r\n\r\n"
+                       : "\r\nConnection: close\r\n\r\n";
+}
+
+void WebServer::Reactor::stream_chunk(Connection& c, const char* data, size_t size) {
+    if (size == 0) return;
+    if (c.chunked) {
+        char len[20];
+        snprintf(len, sizeof(len), "%zx\r\n", size);
+        c.out += len;
+        c.out.append(data, size);
+        c.out += "\r\n";
+    } else {
+        c.out.append(data, size);
+    }
+    if (!c.broken && c.out.size() - c.out_pos >= STREAM_FLUSH_SIZE) flush(c);
+}
+
+void WebServer::Reactor::end_stream(Connection& c) {
+    if (c.chunked) c.out += "0\r\n\r\n";
+    else c.close_after_write = true;
+    c.chunked = false;
+}
+
+// Each page is a short query, so the reactor never blocks on a whole window
+// and at most one page sits in out beyond what the socket has taken.
+void WebServer::Reactor::continue_stream(Connection& c) {
+    HistoryStream& s = *c.stream;
+    while (!s.cursor.done && !c.broken && !backlogged(c)) {
+        if (s.json) db.write_history_page_json(*s.json, s.cursor, STREAM_PAGE_ROWS);
+        else db.write_history_page_binary(*s.binary, s.cursor, STREAM_PAGE_ROWS);
+    }
+    if (!s.cursor.done) return;
+    if (s.json) s.json->flush();
+    c.stream.reset();
+    end_stream(c);
+    flush(c);
+}
+
+// A shared body, if any, always follows everything queued in out; no more
+// requests are processed until it has been sent.
+void WebServer::Reactor::flush(Connection& c) {
+    while (c.out_pos < c.out.size() || c.body) {
+        size_t head = c.out.size() - c.out_pos;
+        const char* body = c.body ? c.body->data() + c.body_pos : nullptr;
+        long n = sock_write2(c.fd, c.out.data() + c.out_pos, head, body, c.body ? c.body->size() - c.body_pos : 0);
+        if (n > 0) {
+            size_t sent = (size_t)n < head ? (size_t)n : head;
+            c.out_pos += sent;
+            if (c.body && (c.body_pos += (size_t)n - sent) == c.body->size()) {
+                c.body.reset();
+                c.body_pos = 0;
             }
+        } else if (n < 0 && would_block()) {
+            break;
+        } else {
+            c.broken = true;
+            return;
         }
-#ifdef _WIN32
-        send(new_socket, response.c_str(), response.size(), 0);
-        closesocket(new_socket);
-#else
-        write(new_socket, response.c_str(), response.size());
-        close(new_socket);
-#endif
     }
+    if (c.out_pos == c.out.size()) {
+        c.out.clear();
+        c.out_pos = 0;
+    } else if (c.out_pos > STREAM_FLUSH_SIZE) {
+        c.out.erase(0, c.out_pos);
+        c.out_pos = 0;
+    }
+    poller.want_write(c.fd, !c.out.empty() || c.body);
+}
+
+void WebServer::Reactor::handle_request(Connection& c, const HttpRequest& request) {
+    struct Route {
+        const char* path;
+        void (Reactor::*handler)(Connection&, const HttpRequest&);
+    };
+    static const Route routes[] = {
+        {"/api/current", &Reactor::handle_current},
+        {"/api/history", &Reactor::handle_history},
+        {"/api/history.bin", &Reactor::handle_history_bin},
+        {"/api/stats", &Reactor::handle_stats},
+        {"/api/stream", &Reactor::handle_stream},
+        {"/api/ws", &Reactor::handle_websocket},
+    };
+    if (request.method != "GET") {
+        respond(c, status_text(405), "text/plain", "");
+        return;
+    }
+    for (const Route& route : routes) {
+        if (request.path == route.path) {
+            (this->*route.handler)(c, request);
+            return;
+        }
+    }
+    handle_static(c, request);
+}
+
+// Bounded API responses are rendered once per data generation and shared
+// between requests and reactors; unbounded history is still streamed.
+void WebServer::Reactor::respond_cached(Connection& c, const std::string& key, const char* content_type,
+                                        const std::function<std::string()>& render) {
+    std::shared_ptr<const std::string> body = cache.get(key, db.generation(), render);
+    c.out += "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: ";
+    c.out += content_type;
+    c.out += "\r\nContent-Length: " + std::to_string(body->size());
+    c.out += c.keep_alive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    if (!body->empty()) c.body = std::move(body);
+    c.body_pos = 0;
+}
+
+void WebServer::Reactor::handle_current(Connection& c, const HttpRequest&) {
+    respond_cached(c, "current", "application/json", [this]() {
+        JsonWriter out;
+        db.write_current_json(out);
+        return std::move(out.str());
+    });
+}
+
+void WebServer::Reactor::handle_history(Connection& c, const HttpRequest& request) {
+    if (request.header("Accept") == "application/octet-stream") {
+        handle_history_bin(c, request);
+        return;
+    }
+    HistoryQuery q = parse_history_query(request);
+    if (q.bounded()) {
+        respond_cached(c, q.key("history"), "application/json", [this, &q]() {
+            JsonWriter out;
+            if (q.cursor()) db.write_history_since_json(out, q.seconds, q.since_id, q.since_ts, q.cursor_limit());
+            else db.write_history_json(out, q.seconds, q.max_points, q.mode);
+            return std::move(out.str());
+        });
+        return;
+    }
+    begin_stream(c, "application/json");
+    c.stream.reset(new HistoryStream());
+    c.stream->cursor = db.open_history_cursor(q.seconds, false);
+    c.stream->json.reset(new JsonWriter([this, &c](const char* data, size_t size) { stream_chunk(c, data, size); }));
+    continue_stream(c);
+}
+
+void WebServer::Reactor::handle_history_bin(Connection& c, const HttpRequest& request) {
+    HistoryQuery q = parse_history_query(request);
+    if (q.bounded()) {
+        respond_cached(c, q.key("history.bin"), "application/octet-stream", [this, &q]() {
+            HistoryBlockWriter out(nullptr);
+            if (q.cursor()) db.write_history_since_binary(out, q.seconds, q.since_id, q.since_ts, q.cursor_limit());
+            else db.write_history_binary(out, q.seconds, q.max_points, q.mode);
+            return std::move(out.str());
+        });
+        return;
+    }
+    begin_stream(c, "application/octet-stream");
+    c.stream.reset(new HistoryStream());
+    c.stream->cursor = db.open_history_cursor(q.seconds, true);
+    c.stream->binary.reset(new HistoryBlockWriter([this, &c](const char* data, size_t size) {
+        stream_chunk(c, data, size);
+    }));
+    continue_stream(c);
+}
+
+void WebServer::Reactor::handle_stats(Connection& c, const HttpRequest&) {
+    JsonWriter out;
+    out.raw("{\"reactor\":{\"connections\":").integer(int64_t(connections.size()));
+    out.raw(",\"push_clients\":").integer(int64_t(push_clients)).raw("}");
+    for (const auto& source : stats) {
+        out.raw(",\"").raw(source.first.c_str()).raw("\":");
+        source.second(out);
+    }
+    out.raw("}");
+    respond(c, "200 OK", "application/json", out.str());
+}
+
+void WebServer::Reactor::handle_stream(Connection& c, const HttpRequest& request) {
+    c.out += "HTTP/1.1 200 OK\r\nAccess-Control-Allow-Origin: *\r\nContent-Type: text/event-stream\r\n"
+             "Cache-Control: no-cache\r\nConnection: close\r\n\r\nretry: 2000\n\n";
+    c.push = Push::Sse;
+    c.keep_alive = false;
+    c.push_cursor = live.head();
+    std::string_view last_id = request.header("Last-Event-ID");
+    if (!last_id.empty()) {
+        uint64_t id = 0;
+        for (char ch : last_id) id = ch >= '0' && ch <= '9' ? id * 10 + (uint64_t)(ch - '0') : 0;
+        if (id > 0 && id < c.push_cursor) c.push_cursor = id + 1;
+    }
+    // Too far behind to resume: move the client's id to the head and tell it to
+    // re-fetch history, instead of silently leaving a gap
+    if (c.push_cursor != live.head() && !live.read_since(c.push_cursor, Broadcast::Format::Sse, c.out)) {
+        c.push_cursor = live.head();
+        c.out += "id: " + std::to_string(c.push_cursor - 1) + "\nevent: reset\ndata: {}\n\n";
+    }
+    ++push_clients;
+}
+
+void WebServer::Reactor::handle_websocket(Connection& c, const HttpRequest& request) {
+    std::string_view key = request.header("Sec-WebSocket-Key");
+    if (!request.header_has_token("Upgrade", "websocket") || !request.header_has_token("Connection", "upgrade") ||
+        key.empty() || request.header("Sec-WebSocket-Version") != "13") {
+        respond(c, "426 Upgrade Required", "text/plain", "WebSocket upgrade required");
+        return;
+    }
+    c.out += "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ";
+    c.out += websocket_accept_key(key);
+    c.out += "\r\n\r\n";
+    c.push = Push::WebSocket;
+    c.push_cursor = live.head();
+    ++push_clients;
+}
+
+void WebServer::Reactor::push_live() {
+    live_seen = live.head();
+    std::vector<int> lagging;
+    for (auto& entry : connections) {
+        Connection& c = entry.second;
+        if (c.push == Push::None || c.broken || c.close_after_write) continue;
+        Broadcast::Format format = c.push == Push::Sse ? Broadcast::Format::Sse : Broadcast::Format::WebSocket;
+        // A subscriber that fell off the ring is closed like one over the backlog
+        // limit; it reconnects and re-fetches history rather than missing events
+        if (!live.read_since(c.push_cursor, format, c.out)) {
+            lagging.push_back(entry.first);
+            continue;
+        }
+        flush(c);
+        if (c.broken || c.out.size() - c.out_pos > MAX_PUSH_BACKLOG) lagging.push_back(entry.first);
+    }
+    for (int fd : lagging) close_connection(fd);
+}
+
+void WebServer::Reactor::handle_static(Connection& c, const HttpRequest& request) {
+    std::shared_ptr<const StaticAsset> asset = assets.get();
+    if (!asset) {
+        respond(c, "404 Not Found", "text/plain", "File not found");
+        return;
+    }
+    const char* connection = c.keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    if (request.header_has_token("If-None-Match", asset->etag) || request.header("If-None-Match") == "*") {
+        c.out += asset->not_modified;
+        c.out += connection;
+        return;
+    }
+    bool gzip = !asset->gzip.body.empty() && request.header_has_token("Accept-Encoding", "gzip");
+    const StaticAsset::Variant& variant = gzip ? asset->gzip : asset->identity;
+    c.out += variant.head;
+    c.out += connection;
+    if (!variant.body.empty()) c.body = std::shared_ptr<const std::string>(asset, &variant.body);
+    c.body_pos = 0;
+}
+
+void WebServer::add_stats(const std::string& name, std::function<void(JsonWriter&)> source) {
+    stats.emplace_back(name, std::move(source));
 }
 
-WebServer::WebServer(int port) : port(port) {}
\ No newline at end of file
+WebServer::WebServer(int port, int threads)
+    : assets("index.html", "text/html; charset=utf-8"), port(port), threads(threads > 0 ? threads : 1) {}
@@ -1,11 +1,107 @@
 #pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include "database.h"
+#include "poller.h"
+#include "http.h"
+#include "broadcast.h"
+#include "static_cache.h"
+#include "response_cache.h"
 
 class WebServer {
 public:
-    WebServer(int port);
+    WebServer(int port, int threads = 1);
     void start(Database& db);
+    void add_stats(const std::string& name, std::function<void(JsonWriter&)> source);
 private:
+    typedef std::vector<std::pair<std::string, std::function<void(JsonWriter&)>>> StatsSources;
+    class Reactor {
+    public:
+        Reactor(Database& db, Broadcast& live, StaticCache& assets, ResponseCache& cache,
+                const StatsSources& stats, int listen_fd);
+        void run();
+    private:
+        enum class Push { None, Sse, WebSocket };
+        // Unbounded history in progress: produced a page at a time while the socket keeps up
+        struct HistoryStream {
+            HistoryCursor cursor;
+            std::unique_ptr<JsonWriter> json;
+            std::unique_ptr<HistoryBlockWriter> binary;
+        };
+        struct Connection {
+            int fd;
+            std::string in;
+            HttpParser parser;
+            std::string out;
+            size_t out_pos = 0;
+            std::shared_ptr<const std::string> body;
+            size_t body_pos = 0;
+            std::unique_ptr<HistoryStream> stream;
+            bool keep_alive = true;
+            bool chunked = false;
+            bool close_after_write = false;
+            bool broken = false;
+            bool read_paused = false;
+            Push push = Push::None;
+            uint64_t push_cursor = 0;
+            std::chrono::steady_clock::time_point last_active;
+        };
+        void accept_clients();
+        void on_readable(Connection& c);
+        void on_writable(Connection& c);
+        void flush(Connection& c);
+        static bool backlogged(const Connection& c);
+        void process_requests(Connection& c);
+        void process_frames(Connection& c);
+        void handle_request(Connection& c, const HttpRequest& request);
+        void handle_current(Connection& c, const HttpRequest& request);
+        void handle_history(Connection& c, const HttpRequest& request);
+        void handle_history_bin(Connection& c, const HttpRequest& request);
+        void handle_stats(Connection& c, const HttpRequest& request);
+        void handle_stream(Connection& c, const HttpRequest& request);
+        void handle_websocket(Connection& c, const HttpRequest& request);
+        void handle_static(Connection& c, const HttpRequest& request);
+        void respond(Connection& c, const char* status, const char* content_type, const std::string& body);
+        void respond_cached(Connection& c, const std::string& key, const char* content_type,
+                            const std::function<std::string()>& render);
+        void begin_stream(Connection& c, const char* content_type);
+        void stream_chunk(Connection& c, const char* data, size_t size);
+        void end_stream(Connection& c);
+        void continue_stream(Connection& c);
+        void push_live();
+        void close_idle();
+        void close_connection(int fd);
+        Database& db;
+        Broadcast& live;
+        StaticCache& assets;
+        ResponseCache& cache;
+        const StatsSources& stats;
+        uint64_t live_seen;
+        size_t push_clients = 0;
+        int listen_fd;
+        Poller poller;
+        std::unordered_map<int, Connection> connections;
+    };
+    struct LiveWindow {
+        int64_t bucket_ms = -1;
+        double min = 0;
+        double max = 0;
+        double sum = 0;
+        uint32_t count = 0;
+    };
+    int open_listener(bool reuse_port);
+    void publish_sample(const Sample& sample);
+    void publish_aggregate();
+    Broadcast live;
+    LiveWindow window;
+    StaticCache assets;
+    ResponseCache cache;
+    StatsSources stats;
     int port;
-};
\ No newline at end of file
+    int threads;
+};
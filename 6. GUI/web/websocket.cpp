@@ -0,0 +1,108 @@
+#include "websocket.h"
+
+static uint32_t rol(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1(const std::string& message, unsigned char digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    uint64_t bits = uint64_t(message.size()) * 8;
+    data += char(0x80);
+    while (data.size() % 64 != 56) data += char(0);
+    for (int i = 7; i >= 0; --i) data += char((bits >> (8 * i)) & 0xff);
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data() + block + 4 * i);
+            w[i] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+        }
+        for (int i = 16; i < 80; ++i) w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rol(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; ++i) digest[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+static std::string base64(const unsigned char* data, size_t size) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t n = uint32_t(data[i]) << 16;
+        if (i + 1 < size) n |= uint32_t(data[i + 1]) << 8;
+        if (i + 2 < size) n |= data[i + 2];
+        out += table[(n >> 18) & 63];
+        out += table[(n >> 12) & 63];
+        out += i + 1 < size ? table[(n >> 6) & 63] : '=';
+        out += i + 2 < size ? table[n & 63] : '=';
+    }
+    return out;
+}
+
+std::string websocket_accept_key(std::string_view client_key) {
+    unsigned char digest[20];
+    sha1(std::string(client_key) + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11", digest);
+    return base64(digest, sizeof(digest));
+}
+
+void websocket_frame(std::string& out, WsOpcode opcode, const char* data, size_t size) {
+    out += char(0x80 | uint8_t(opcode));
+    if (size < 126) {
+        out += char(size);
+    } else if (size <= 0xffff) {
+        out += char(126);
+        out += char((size >> 8) & 0xff);
+        out += char(size & 0xff);
+    } else {
+        out += char(127);
+        for (int i = 7; i >= 0; --i) out += char((uint64_t(size) >> (8 * i)) & 0xff);
+    }
+    out.append(data, size);
+}
+
+WebSocketParser::Result WebSocketParser::parse(std::string_view buffer, WebSocketFrame& frame, size_t& consumed) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(buffer.data());
+    if (buffer.size() < 2) return Result::Incomplete;
+    frame.fin = (p[0] & 0x80) != 0;
+    frame.opcode = WsOpcode(p[0] & 0x0f);
+    bool masked = (p[1] & 0x80) != 0;
+    uint64_t length = p[1] & 0x7f;
+    size_t pos = 2;
+    if ((p[0] & 0x70) || !masked) return Result::Error;
+    if (length == 126) {
+        if (buffer.size() < 4) return Result::Incomplete;
+        length = uint64_t(p[2]) << 8 | p[3];
+        pos = 4;
+    } else if (length == 127) {
+        if (buffer.size() < 10) return Result::Incomplete;
+        length = 0;
+        for (int i = 0; i < 8; ++i) length = length << 8 | p[2 + i];
+        pos = 10;
+    }
+    bool control = uint8_t(frame.opcode) >= 8;
+    if (length > MAX_PAYLOAD || (control && (length > 125 || !frame.fin))) return Result::Error;
+    if (buffer.size() < pos + 4 + length) return Result::Incomplete;
+    const unsigned char* mask = p + pos;
+    pos += 4;
+    frame.payload.resize(size_t(length));
+    for (size_t i = 0; i < length; ++i) frame.payload[i] = char(p[pos + i] ^ mask[i & 3]);
+    consumed = pos + size_t(length);
+    return Result::Complete;
+}
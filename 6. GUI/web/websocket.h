@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// RFC 6455 framing. The server sends unmasked frames and accepts only
+// masked client frames; fragmented messages are not reassembled.
+enum class WsOpcode : uint8_t { Continuation = 0, Text = 1, Binary = 2, Close = 8, Ping = 9, Pong = 10 };
+
+struct WebSocketFrame {
+    WsOpcode opcode;
+    bool fin;
+    std::string payload;
+};
+
+class WebSocketParser {
+public:
+    enum class Result { Incomplete, Complete, Error };
+    static const size_t MAX_PAYLOAD = 64 * 1024;
+    static Result parse(std::string_view buffer, WebSocketFrame& frame, size_t& consumed);
+};
+
+std::string websocket_accept_key(std::string_view client_key);
+void websocket_frame(std::string& out, WsOpcode opcode, const char* data, size_t size);